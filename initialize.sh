@@ -1,5 +1,5 @@
 
-# create an image containing the executable games in the bin
+# build everything and pack the games in bin into a bundle
 
 # check for dependencies and install it if it is not installed
 if ! dpkg -l | grep -q ncurses; then
@@ -7,30 +7,34 @@ if ! dpkg -l | grep -q ncurses; then
   sudo apt update && sudo apt install -y libncurses5-dev libncursesw5-dev
 fi
 
+# compile the shared code in src/lib once, every executable links against it
+mkdir -p build
+for lib_file in src/lib/*.c; do
+  gcc -c -pthread -fPIC -o "./build/$(basename "$lib_file" .c).o" "$lib_file"  # PIC, the game plugins link it too
+done
+rm -f build/libvgc.a
+ar rcs build/libvgc.a build/*.o
+
 # compile the .c files in src and put the executables in bin
 mkdir -p bin
 for src_file in src/*.c; do
   file=$(basename "$src_file" .c)
-  gcc -o "./bin/${file}" "$src_file" -lncurses  # Compile with ncurses
+  # -rdynamic so a plugin loaded by the console uses the console's renderer and trace state
+  gcc -pthread -rdynamic -o "./bin/${file}" "$src_file" build/libvgc.a -lncurses -ldl -lm  # Compile with ncurses
 done
 
-# create (or override) the image file and format it with ext4
-dd if=/dev/zero of=storage_vgc.img bs=1M count=50 conv=notrunc
-sudo mkfs.ext4 storage_vgc.img
-
-mkdir -p mount
-sudo mount -o loop storage_vgc.img mount/
-
-sudo chown -R "$(whoami):$(whoami)" mount
-sudo chmod -R 777 mount
-
-# copy the executables to the mounted image
-cp bin/* mount/
-
-# unmount the image and clean up
-sudo umount mount
-sudo rm -rf mount
-
-
+# the games that implement the plugin ABI in src/lib/game_host.h are built again as a .so the console runs in-process
+for src_file in $(grep -l VGC_PLUGIN src/*.c); do
+  file=$(basename "$src_file" .c)
+  gcc -pthread -shared -fPIC -DVGC_PLUGIN -o "./bin/${file}.so" "$src_file" build/libvgc.a
+done
 
+# the developer tools in src/tools go to bin as well, they are not games so the console doesn't list them
+for src_file in src/tools/*.c; do
+  file=$(basename "$src_file" .c)
+  gcc -pthread -o "./bin/${file}" "$src_file" build/libvgc.a -lncurses
+done
 
+# pack the games into a single bundle file, the console maps it and runs the games straight out of it
+# (no image to format and nothing to mount, so no root needed)
+./bin/vgc-pack storage_vgc.vgc bin/game_*
@@ -1,13 +1,7 @@
 
-# along with the removals of terminate.sh, also remove the created img file
+# along with the removals of terminate.sh, also remove the bundle (and an old image file if there is one)
 
-sudo umount mount
-sudo rm /dev/vgc-disk
-rm -r mount
-rm vgc-disk
-if sudo losetup -a | grep -q "storage_vgc.img"; then
-    loop_device=$(sudo losetup -a | grep "storage_vgc.img" | cut -d ':' -f 1)
-    sudo losetup -d "$loop_device"
-fi
-
-rm storage_vgc.img
+./terminate.sh
+rm -f storage_vgc.vgc storage_vgc.img
+rm -f /dev/shm/vgc-spectate-*  # spectator rings of games that were killed before they could remove theirs
+rm -f /dev/shm/vgc-perf-*      # and their live counters
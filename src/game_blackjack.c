@@ -1,9 +1,396 @@
+#define _GNU_SOURCE // pthread_setaffinity_np
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <termios.h>
+#include <string.h>
 #include <unistd.h>
-#include <ncurses.h>
-#include <signal.h>
-#include <time.h>
 
+#include "lib/blackjack_core.h"
+#include "lib/clock.h"
+#include "lib/game_host.h"
+#include "lib/game_info.h"
+#include "lib/hash.h"
+#include "lib/render.h"
 
+#define decks_in_shoe 6
+#define starting_chips 100
+#define chips_per_bet 10
+
+typedef struct {
+    BlackjackTable table;
+    Strategy hint; // basic strategy, shown next to the hand
+    int chips;
+    int pending_key; // the last key since the previous tick, the tick applies it
+    int changed;     // the screen needs to be drawn again
+} BlackjackGame;
+
+static const char rank_chars[] = "A23456789TJQK";
+static const char suit_chars[] = "shdc";
+static const char* action_names[] = {"hit", "stand", "double", "split"};
+
+// "Ks 7h 9c", or "Ks ??" for the dealer while the round is on
+static void format_hand(char* out, const Hand* h, const int hide_second) {
+    int n = 0;
+    for (int i = 0; i < h->count; i++) {
+        if (i == 1 && hide_second)
+            n += sprintf(out + n, "?? ");
+        else
+            n += sprintf(out + n, "%c%c ", rank_chars[card_rank(h->cards[i])], suit_chars[card_suit(h->cards[i])]);
+    }
+    out[n] = '\0';
+}
+
+// half bets to chips
+static int chips_won(const int result) {
+    return result * chips_per_bet / 2;
+}
+
+static void draw_table(Renderer* renderer, const BlackjackGame* game) {
+    const BlackjackTable* t = &game->table;
+    char cards[64];
+    int y = 0;
+
+    renderer_print(renderer, 0, y++, "%-70s", "BLACKJACK");
+    renderer_print(renderer, 0, y++, "chips: %-5d bet: %-4d shoe: %d cards left%-20s", game->chips, chips_per_bet,
+                   t->shoe.num_cards - t->shoe.next, "");
+    y++;
+
+    format_hand(cards, &t->dealer, t->in_round);
+    if (t->in_round)
+        renderer_print(renderer, 0, y++, "Dealer:  %-40s%-21s", cards, "");
+    else
+        renderer_print(renderer, 0, y++, "Dealer:  %-40s= %-2d%-17s", cards, hand_total(&t->dealer),
+                       t->dealer_busted ? " busts" : "");
+    y++;
+
+    for (int i = 0; i < bj_max_hands; i++) {
+        if (i >= t->num_hands) {
+            renderer_print(renderer, 0, y++, "%-70s", "");
+            continue;
+        }
+        const Hand* h = &t->hands[i];
+        char result[32] = "";
+        if (!t->in_round)
+            snprintf(result, sizeof(result), hand_is_blackjack(h) ? "blackjack %+d" : "%+d", chips_won(t->results[i]));
+        else if (hand_total(h) > 21)
+            snprintf(result, sizeof(result), "bust");
+        format_hand(cards, h, 0);
+        // up to bj_max_cards cards of 3 columns, the result and "doubled" still fit in 80 columns after them
+        renderer_print(renderer, 0, y++, "%c Hand %d: %-38s= %-2d %-4s %-13s %-7s", t->in_round && i == t->current ? '>' : ' ',
+                       i + 1, cards, hand_total(h), hand_is_soft(h) && hand_total(h) < 21 ? "soft" : "", result,
+                       h->bet == 2 ? "doubled" : "");
+    }
+    y++;
+
+    if (t->in_round)
+        renderer_print(renderer, 0, y++, "basic strategy says %-50s", action_names[strategy_action(&game->hint, t)]);
+    else if (game->chips < chips_per_bet)
+        renderer_print(renderer, 0, y++, "%-70s", "Out of chips. Press q to quit");
+    else
+        renderer_print(renderer, 0, y++, "%s %-40d", t->net > 0 ? "You won" : t->net < 0 ? "You lost" : "Push,",
+                       abs(chips_won(t->net)));
+    y++;
+
+    if (t->in_round) {
+        const int allowed = blackjack_allowed(t);
+        renderer_print(renderer, 0, y, "h hit  s stand  %s  %s  q quit%-20s", allowed & BJ_CAN(BJ_DOUBLE) ? "d double" : "        ",
+                       allowed & BJ_CAN(BJ_SPLIT) ? "p split" : "       ", "");
+    }
+    else
+        renderer_print(renderer, 0, y, "%-70s", "n next hand  q quit");
+}
+
+static void settle_chips(BlackjackGame* game) {
+    if (!game->table.in_round)
+        game->chips += chips_won(game->table.net);
+}
+
+void* blackjack_init(const unsigned long seed) {
+    BlackjackGame* game = malloc(sizeof(BlackjackGame));
+    if (game == NULL)
+        return NULL;
+    memset(game, 0, sizeof(BlackjackGame));
+
+    blackjack_setup(&game->table, decks_in_shoe, seed);
+    load_strategy(&game->hint, "basic");
+    game->chips = starting_chips;
+    blackjack_deal(&game->table);
+    settle_chips(game); // a blackjack on the first deal is already settled
+    game->changed = 1;
+    return game;
+}
+
+// keys wait for the tick like in the other games, so a recording replays the same hands
+void blackjack_input(void* state, const int key) {
+    BlackjackGame* game = state;
+    game->pending_key = key;
+}
+
+int blackjack_tick(void* state) {
+    BlackjackGame* game = state;
+    BlackjackTable* t = &game->table;
+    const int key = game->pending_key;
+    game->pending_key = 0;
+    if (key == 0)
+        return game->chips < chips_per_bet && !t->in_round;
+
+    if (t->in_round) {
+        const int action = key == 'h' ? BJ_HIT : key == 's' ? BJ_STAND : key == 'd' ? BJ_DOUBLE : key == 'p' ? BJ_SPLIT : -1;
+        if (action != -1 && (blackjack_allowed(t) & BJ_CAN(action))) {
+            blackjack_act(t, action);
+            settle_chips(game);
+            game->changed = 1;
+        }
+    }
+    else if ((key == 'n' || key == ' ' || key == '\n') && game->chips >= chips_per_bet) {
+        blackjack_deal(t);
+        settle_chips(game);
+        game->changed = 1;
+    }
+    return game->chips < chips_per_bet && !t->in_round;
+}
+
+void blackjack_render(void* state, Renderer* renderer, const int full) {
+    BlackjackGame* game = state;
+    if (full || game->changed)
+        draw_table(renderer, game);
+    game->changed = 0;
+}
+
+void blackjack_shutdown(void* state) {
+    free(state);
+}
+
+uint64_t blackjack_state_hash(void* state) {
+    BlackjackGame* game = state;
+    // the table is one flat struct with the shoe in it, zeroed when it was set up
+    return hash_int(hash_bytes(hash_init, &game->table, sizeof(BlackjackTable)), game->chips);
+}
+
+// the chips left when the player walks away
+int64_t blackjack_score(void* state) {
+    BlackjackGame* game = state;
+    return game->chips;
+}
+
+// exported as is when built as a plugin, see lib/game_host.h
+const VgcGame vgc_game = {
+    .abi_version = VGC_GAME_ABI,
+    .name = "game_blackjack",
+    .tick_hz = 20, // nothing moves on its own, the tick only has to be quick to answer a key
+    .render_hz = 20,
+    .init = blackjack_init,
+    .input = blackjack_input,
+    .step = blackjack_tick,
+    .render = blackjack_render,
+    .shutdown = blackjack_shutdown,
+    .hash = blackjack_state_hash,
+    .score = blackjack_score,
+};
+
+// what the console's menu lists for this game, read from the file without running it
+VGC_GAME_INFO("Blackjack", "6-deck blackjack with splits and doubles, basic strategy shown under your hand", "Virtual Game Console");
+
+#ifndef VGC_PLUGIN
+
+/*  --evaluate: the same engine without a screen, playing a strategy table on every core.
+ *  The hands are cut into blocks of eval_block hands and block b is always played on a shoe seeded with seed + b,
+ *  so the numbers only depend on --seed and --hands, not on the thread count. The threads take blocks from one
+ *  atomic counter, a block takes long enough that they never contend on it.
+ */
+
+#define eval_block 1000000
+
+typedef struct {
+    long rounds;
+    long long net;    // half bets
+    long long net_sq; // for the variance
+    long won;
+    long pushed;
+    long lost;
+    long blackjacks;
+    long hands;   // after splits
+    long doubles;
+    long splits;
+    long player_busts;
+    long dealer_busts;
+} EvalStats;
+
+typedef struct {
+    alignas(64) EvalStats stats; // a cache line of its own, only its thread writes it
+    int id;
+    int cpu;
+    long long busy_ns;
+    pthread_t thread;
+} EvalWorker;
+
+typedef struct {
+    long hands;
+    int threads;
+    int decks;
+    unsigned long seed;
+    Strategy strategy;
+} EvalConfig;
+
+static EvalConfig eval = {.hands = 100000000, .decks = decks_in_shoe, .seed = 1};
+static _Atomic long next_block;
+
+static void play_block(EvalStats* s, const long block, const long rounds) {
+    BlackjackTable t;
+    blackjack_setup(&t, eval.decks, eval.seed + block);
+    for (long i = 0; i < rounds; i++) {
+        blackjack_deal(&t);
+        while (t.in_round)
+            blackjack_act(&t, strategy_action(&eval.strategy, &t));
+
+        s->net += t.net;
+        s->net_sq += t.net * t.net;
+        s->won += t.net > 0;
+        s->pushed += t.net == 0;
+        s->lost += t.net < 0;
+        s->blackjacks += hand_is_blackjack(&t.hands[0]);
+        s->hands += t.num_hands;
+        s->splits += t.num_hands - 1;
+        s->dealer_busts += t.dealer_busted;
+        for (int h = 0; h < t.num_hands; h++) {
+            s->doubles += t.hands[h].bet == 2;
+            s->player_busts += hand_total(&t.hands[h]) > 21;
+        }
+    }
+    s->rounds += rounds;
+}
+
+static void* eval_worker_main(void* arg) {
+    EvalWorker* w = arg;
+    if (eval.threads <= sysconf(_SC_NPROCESSORS_ONLN)) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    w->cpu = sched_getcpu();
+
+    const long long start = monotonic_ns();
+    const long blocks = (eval.hands + eval_block - 1) / eval_block;
+    long block;
+    while ((block = atomic_fetch_add(&next_block, 1)) < blocks) {
+        const long rounds = block == blocks - 1 ? eval.hands - block * eval_block : eval_block;
+        play_block(&w->stats, block, rounds);
+    }
+    w->busy_ns = monotonic_ns() - start;
+    return NULL;
+}
+
+static int parse_eval_args(const int argc, char** argv) {
+    const char* strategy = "basic";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--evaluate") == 0)
+            continue;
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            fprintf(stderr, "game_blackjack: %s needs a value\n", argv[i]);
+            return -1;
+        }
+        if (strcmp(argv[i], "--hands") == 0)
+            eval.hands = (long) strtod(value, NULL); // 1e8 works too
+        else if (strcmp(argv[i], "--threads") == 0)
+            eval.threads = (int) strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--decks") == 0)
+            eval.decks = (int) strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0)
+            eval.seed = strtoul(value, NULL, 0);
+        else if (strcmp(argv[i], "--strategy") == 0)
+            strategy = value;
+        else {
+            fprintf(stderr, "usage: game_blackjack --evaluate [--hands N] [--threads K] [--decks D] [--seed S] "
+                            "[--strategy basic|dealer|never-bust|<file>]\n");
+            return -1;
+        }
+        i++;
+    }
+    if (eval.threads <= 0)
+        eval.threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (eval.hands <= 0 || eval.decks < 1 || eval.decks > bj_max_decks) {
+        fprintf(stderr, "game_blackjack: --hands has to be positive and --decks between 1 and %d\n", bj_max_decks);
+        return -1;
+    }
+    if (load_strategy(&eval.strategy, strategy) == -1) {
+        fprintf(stderr, "game_blackjack: can't load strategy %s: %s\n", strategy,
+                errno == EINVAL ? "a line is not '<hard|soft|pair> <n>: <10 actions>'" : strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int evaluate(const int argc, char** argv) {
+    if (parse_eval_args(argc, argv) == -1)
+        return 2;
+
+    EvalWorker* workers = aligned_alloc(64, sizeof(EvalWorker) * eval.threads);
+    if (workers == NULL) {
+        fprintf(stderr, "game_blackjack: can't allocate %d workers: %s\n", eval.threads, strerror(errno));
+        return 1;
+    }
+    memset(workers, 0, sizeof(EvalWorker) * eval.threads);
+    const long long start = monotonic_ns();
+    for (int i = 0; i < eval.threads; i++) {
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, eval_worker_main, &workers[i]);
+    }
+    EvalStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < eval.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        const EvalStats* s = &workers[i].stats;
+        total.rounds += s->rounds;
+        total.net += s->net;
+        total.net_sq += s->net_sq;
+        total.won += s->won;
+        total.pushed += s->pushed;
+        total.lost += s->lost;
+        total.blackjacks += s->blackjacks;
+        total.hands += s->hands;
+        total.doubles += s->doubles;
+        total.splits += s->splits;
+        total.player_busts += s->player_busts;
+        total.dealer_busts += s->dealer_busts;
+    }
+    const double seconds = (monotonic_ns() - start) / 1e9;
+
+    // results are in half bets, per round of one initial bet
+    const double n = (double) total.rounds;
+    const double mean = total.net / 2.0 / n;
+    const double variance = total.net_sq / 4.0 / n - mean * mean;
+    const double margin = 1.96 * sqrt(variance / n);
+
+    printf("blackjack, strategy %s, %d decks: %ld rounds in %.2f s (%.1f M rounds/s on %d threads)\n",
+           eval.strategy.name, eval.decks, total.rounds, seconds, n / seconds / 1e6, eval.threads);
+    printf("  EV %+.3f%% of the bet per round, 95%% confidence +-%.3f%%, variance %.3f (sd %.3f)\n", 100.0 * mean,
+           100.0 * margin, variance, sqrt(variance));
+    printf("  rounds won %.2f%%, pushed %.2f%%, lost %.2f%%, blackjacks %.2f%%\n", 100.0 * total.won / n,
+           100.0 * total.pushed / n, 100.0 * total.lost / n, 100.0 * total.blackjacks / n);
+    printf("  hands doubled %.2f%%, split %.2f%% of the rounds, player busts %.2f%% of the hands, dealer busts %.2f%%\n",
+           100.0 * total.doubles / total.hands, 100.0 * total.splits / n, 100.0 * total.player_busts / total.hands,
+           100.0 * total.dealer_busts / n);
+    for (int i = 0; i < eval.threads; i++) {
+        const EvalWorker* w = &workers[i];
+        printf("  worker %d on cpu %d: %ld rounds, %.1f M rounds/s\n", w->id, w->cpu, w->stats.rounds,
+               w->busy_ns > 0 ? w->stats.rounds / (w->busy_ns / 1e9) / 1e6 : 0.0);
+    }
+    free(workers);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--evaluate") == 0)
+            return evaluate(argc, argv);
+    }
+    return run_standalone(&vgc_game, argc, argv);
+}
+#endif
@@ -1,224 +1,170 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <termios.h>
 #include <unistd.h>
 #include <ncurses.h>
-#include <signal.h>
-#include <time.h>
 
+#include "lib/game_host.h"
+#include "lib/game_info.h"
+#include "lib/racing_core.h"
+#include "lib/render.h"
 
-#define char_car 'O'
-#define char_obstacle '#'
-#define char_empty ' '
 
-#define road_width_inner 7
-#define road_height 25
-#define pixels_count (road_width_inner * road_height)
-#define max_obstacle_density (1.0 / road_width_inner)
-#define max_obstacles (road_width_inner * road_height * max_obstacle_density)
 typedef struct {
-    int car_x;
-    int car_y; // constant
+    Road* road;
 
-    int num_obstacles;
+    // the rows as they are on the screen, in screen order, diffed against the road with XOR after every step
+    uint64_t* shown_rows;
+    int shown_car_x;
 
-    // a pixel is either obstacle or empty, I only use it to track obstacles
-    char pixels[road_width_inner * road_height]; // (x, y) for pixel i = (pixel[i] % width_inner, pixel[i] / width_inner)
-} Road;
+    int last_valid_input;
+    long distance; // rows driven without crashing, the score
+} RacingGame;
 
-Road* road; // global so that we can free it in cleanup
-
-Road* create_initial_road() {
-
-    road = malloc(sizeof(Road));
-
-    road->car_x = road_width_inner / 2;
-    road->car_y = road_height - 1;
-
-    road->num_obstacles = 0;
-
-    // start with empty road, obstacles will spawn in the update function
-    for (int i=0; i<pixels_count; i++)
-        road->pixels[i] = char_empty;
-    road->pixels[road->car_y * road_width_inner + road->car_x] = char_car;
+void update_pixel(Renderer* renderer, const int x, const int y, const char c) {
+    renderer_put(renderer, x+1, y, c); // +1 to skip the left border, sent in renderer_flush with the rest of the tick
+}
 
-    return road;
+void draw_car(Renderer* renderer, RacingGame* game) {
+    Road* road = game->road;
+    if (game->shown_car_x != road->car_x)
+        update_pixel(renderer, game->shown_car_x, road->car_y,
+                     road_has_obstacle(road, game->shown_car_x, road->car_y) ? char_obstacle : char_road);
+    update_pixel(renderer, road->car_x, road->car_y, road->crashed ? char_crash : char_car);
+    game->shown_car_x = road->car_x;
 }
 
-void print_initial_road(Road* road) {
-    clear();
-    for (int y = 0; y < road_height; y++) {
-        printw("|");
-        for (int x = 0; x < road_width_inner; x++) {
-            printw("%c", road->pixels[x + y * road_width_inner]);
+void print_initial_road(Renderer* renderer, RacingGame* game) {
+    Road* road = game->road;
+    for (int y = 0; y < road->height; y++) {
+        renderer_put(renderer, 0, y, '|');
+        for (int x = 0; x < road->width; x++) {
+            update_pixel(renderer, x, y, road_has_obstacle(road, x, y) ? char_obstacle : char_road);
         }
-        printw("|");
-        printw("\n");
+        renderer_put(renderer, road->width + 1, y, '|');
+        memcpy(game->shown_rows + (long) y * road->words_per_row, road_row(road, y),
+               sizeof(uint64_t) * road->words_per_row);
     }
-    refresh();
+    game->shown_car_x = road->car_x;
+    draw_car(renderer, game);
 }
 
-void update_pixel(Road* road, const int x, const int y, const char c) {
-    road->pixels[x + y * road_width_inner] = c;
-    mvprintw(y, x+1, "%c", c); // +1 to skip the left border
-    refresh();
+// only the set bits of shown ^ current are pixels that changed
+void draw_changed_rows(Renderer* renderer, RacingGame* game) {
+    Road* road = game->road;
+    for (int y = 0; y < road->height; y++) {
+        const uint64_t* row = road_row(road, y);
+        uint64_t* shown = game->shown_rows + (long) y * road->words_per_row;
+
+        for (int w = 0; w < road->words_per_row; w++) {
+            uint64_t changed = shown[w] ^ row[w];
+            while (changed != 0) {
+                const int bit = __builtin_ctzll(changed);
+                update_pixel(renderer, w * 64 + bit, y, (row[w] >> bit) & 1 ? char_obstacle : char_road);
+                changed &= changed - 1;
+            }
+            shown[w] = row[w];
+        }
+    }
+    draw_car(renderer, game); // the car isn't part of the rows, it goes on top
 }
 
-#define right 1
-#define left (-1)
-#define neutral 0
-int direction(char ch) {
+int direction(const int ch) {
     switch (ch) {
-        case 'd': return right;
-        case 'a': return left;
+        case 'd':
+        case KEY_RIGHT: return right;
+        case 'a':
+        case KEY_LEFT: return left;
         default: return neutral;
     }
 }
 
-int lower_obstacles_and_check_collision(Road* road) {
-    int collision = 0;
-    for (int i=road_width_inner * road_height - 1; i >= 0; i--) {
-        if (road->pixels[i] != char_obstacle)
-            continue;
-
-        int x = i % road_width_inner;
-        int y = i / road_width_inner;
-
-        int next_x = x;
-        int next_y = y + 1;
-
-        if (next_y == road->car_y && next_x == road->car_x) {
-            collision = 1;
-            // mvprintw(y, x+1, "X");
-            update_pixel(road, next_x, next_y, 'X');
-            refresh();
-        }
-
-        if (next_y == road_height) {
-            update_pixel(road, x, y, char_empty);
-            road->num_obstacles--;
-        }
-        else {
-            update_pixel(road, x, y, char_empty);
-            update_pixel(road, next_x, next_y, char_obstacle);
-        }
+void* racing_init(const unsigned long seed) {
+    RacingGame* game = malloc(sizeof(RacingGame));
+    if (game == NULL)
+        return NULL;
 
+    game->road = create_initial_road(road_width_inner, road_height, seed);
+    if (game->road == NULL) {
+        free(game);
+        return NULL;
     }
-    return collision;
-}
-
-void spawn_obstacles_probabilistically(Road* road) {
-    for (int i=0; i<road_width_inner; i++) {
-        if (road->num_obstacles >= max_obstacles)
-            return;
-
-        int spawn = rand() % road_width_inner;
-        while (road->pixels[spawn] == char_obstacle)
-            spawn = rand() % road_width_inner;
-
-        if (rand() < max_obstacle_density * RAND_MAX) {
-            road->num_obstacles++;
-            update_pixel(road, spawn, 0, char_obstacle);
-        }
-
+    game->shown_rows = calloc((long) game->road->height * game->road->words_per_row, sizeof(uint64_t));
+    if (game->shown_rows == NULL) {
+        free_road(game->road);
+        free(game);
+        return NULL;
     }
+    game->shown_car_x = game->road->car_x;
+    game->last_valid_input = neutral;
+    game->distance = 0;
+    return game;
 }
 
-int move_car_and_update_frame(Road* road, int direction) {
-    int next_x = road->car_x + direction;
-    if (next_x < 0 || next_x >= road_width_inner || road->pixels[road->car_y * road_width_inner + next_x] == char_obstacle)
-        next_x = road->car_x;
-    int next_y = road->car_y;
-
-
-    if (next_x != road->car_x) {
-        update_pixel(road, road->car_x, road->car_y, char_empty);
-        update_pixel(road, next_x, next_y, char_car);
-        road->car_x = next_x;
-    }
-
-    int collision = lower_obstacles_and_check_collision(road);
-    spawn_obstacles_probabilistically(road);
-
-    return collision;
+// the car moves one lane per tick, so of the keys in a tick's batch the last one wins
+void racing_input(void* state, const int key) {
+    RacingGame* game = state;
+    if (direction(key) != neutral)
+        game->last_valid_input = direction(key);
 }
 
-
-
-// TODO
-void cleanup() {
-    clear();
-    endwin();
-    system("clear");
+// the rules live in lib/racing_core.c
+int racing_tick(void* state) {
+    RacingGame* game = state;
+    const int events = racing_step(game->road, game->last_valid_input);
+    game->last_valid_input = neutral;
+    if (events & RACING_COLLISION)
+        return 1;
+    game->distance++;
+    return 0;
 }
 
-void handle_sigint() {
-    cleanup();
-    exit(0);
+// this only draws what the step changed
+void racing_render(void* state, Renderer* renderer, const int full) {
+    if (full)
+        print_initial_road(renderer, state);
+    else
+        draw_changed_rows(renderer, state);
 }
 
-void handle_sigterm() {
-    cleanup();
-    exit(0);
+void racing_shutdown(void* state) {
+    RacingGame* game = state;
+    free_road(game->road);
+    free(game->shown_rows);
+    free(game);
 }
 
+uint64_t racing_state_hash(void* state) {
+    RacingGame* game = state;
+    return racing_hash(game->road);
+}
 
-int main() {
-    signal(SIGINT, handle_sigint);
-    signal(SIGTERM, handle_sigterm);
-
-    initscr();             // Start ncurses mode
-    cbreak();              // Disable line buffering
-    keypad(stdscr, TRUE);  // Enable arrow keys
-    noecho();              // Don't display typed characters
-    nodelay(stdscr, TRUE); // make getch non-blocking
-    curs_set(0);           // Hide the cursor
-
-    road = create_initial_road();
-    print_initial_road(road);
-
-    const int fps = 5; // also affects the speed of the snake, BE CAREFUL
-    const int frame_delay_ms = 1000 / fps; // delay between screen updates
-    const int input_poll_ms = 20;
-
-    int run = 1;
-    int game_over = 0;
-    struct timespec last_frame_time;
-    clock_gettime(CLOCK_MONOTONIC, &last_frame_time);
-
-    int last_valid_input = neutral;
-
-    while (run) {
-
-        char ch = getch();
-        if (ch >= 'A' && ch <= 'Z')
-            ch += 32; // make lowercase
-        if (ch == 'q')
-            run = 0;
-
-        if (game_over)
-            continue;
-
-        struct timespec current_time;
-        clock_gettime(CLOCK_MONOTONIC, &current_time);
-        long elapsed_time_ms = (current_time.tv_sec - last_frame_time.tv_sec) * 1000
-                             + (current_time.tv_nsec - last_frame_time.tv_nsec) / 1000000;
-
-        if (direction(ch) != neutral) {
-            last_valid_input = direction(ch);
-        }
-
-        if (elapsed_time_ms >= frame_delay_ms) {
-            int collision = move_car_and_update_frame(road, last_valid_input);
-            last_valid_input = neutral;
-            game_over = collision;
-            last_frame_time = current_time;
-        }
-
-        napms(input_poll_ms);
-    }
-
-
+int64_t racing_score(void* state) {
+    RacingGame* game = state;
+    return game->distance;
+}
 
-    cleanup();
-}
\ No newline at end of file
+// exported as is when built as a plugin, see lib/game_host.h
+const VgcGame vgc_game = {
+    .abi_version = VGC_GAME_ABI,
+    .name = "game_racing",
+    .tick_hz = 5, // also affects the speed of the obstacles, BE CAREFUL
+    .render_hz = 5, // nothing changes between ticks, so more than tick_hz only adds wakeups
+    .init = racing_init,
+    .input = racing_input,
+    .step = racing_tick,
+    .render = racing_render,
+    .shutdown = racing_shutdown,
+    .hash = racing_state_hash,
+    .score = racing_score,
+};
+
+// what the console's menu lists for this game, read from the file without running it
+VGC_GAME_INFO("Racing", "Steer around the obstacles on an endless road that gets denser", "Virtual Game Console");
+
+#ifndef VGC_PLUGIN
+int main(int argc, char** argv) {
+    return run_standalone(&vgc_game, argc, argv);
+}
+#endif
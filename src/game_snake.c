@@ -1,248 +1,221 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <termios.h>
 #include <unistd.h>
 #include <ncurses.h>
-#include <signal.h>
-#include <time.h>
 
-#define width 20
-#define height 25
-
-#define char_head 'O'
-#define char_tail '#'
-#define char_bait 'X'
-#define char_empty '.'
+#include "lib/game_host.h"
+#include "lib/game_info.h"
+#include "lib/hash.h"
+#include "lib/render.h"
+#include "lib/snake_core.h"
 
+#define max_turns 4 // turns typed ahead, one is taken per tick
 
 typedef struct {
-    char* cells; // 1D array of cells implemented treated as a 2D array
-
-    /*  1D circular array, having the max size snake can have. It is actually a circular array, keeping the past positions
-     *  of the snake head. To get the full position of the snake, start from the head and trace back the array snake_length times
-     */
-    int* snake;
-    int snake_head_idx;
-    int snake_length;
-    int snake_direction; // 0: up, 1: right, 2: down, 3: left
-} Board;
-
-
-Board* board; // global so that we can free it in cleanup
-
-
-/* top left corner: (0, 0)
-* bottom right corner: (width-1, height-1) */
-int indexOf(int x, int y) {
-    return x + y * width;
-}
-
-Board* create_initial_board() {
-    // set seed as current time for rand
-    srand(time(NULL));
-
-    board = malloc(sizeof(Board));
-
-    if (board == NULL) {
-        printf("Failed to allocate memory for the board\n");
-        return NULL;
-    }
-
-    board->cells = (char*) malloc(sizeof(char*) * width * height);
-    board->snake = (int*) malloc(sizeof(int) * width * height);
-    board->snake_length = 2;
-    board->snake_head_idx = 1;
-
-    // initial field of empty cells
-    for (int i = 0; i < width * height; i++) {
-        board->cells[i] = char_empty;
+    Board* board;
+    int turns[max_turns]; // where the next ticks go, oldest first, none to keep going straight
+    int num_turns;
+    int won;
+
+    // the part of the board on the screen, only for drawing, it isn't part of the game state
+    int view_x;
+    int view_y;
+    int view_width;  // in cells, 0 until the first full render
+    int view_height;
+} SnakeGame;
+
+#define cell_columns 3 // a cell and 2 spaces, so the board isn't squashed sideways
+
+// VGC_SNAKE_BOARD=<width>x<height>, the default board otherwise or if it doesn't parse
+static void board_size(int* width, int* height) {
+    *width = default_board_width;
+    *height = default_board_height;
+    const char* size = getenv("VGC_SNAKE_BOARD");
+    int w, h;
+    if (size != NULL && sscanf(size, "%dx%d", &w, &h) == 2 && w >= 3 && w <= board_max_side && h >= 1 && h <= board_max_side) {
+        *width = w;
+        *height = h;
     }
-
-    // put snake in the middle
-    int snake_pos = width * height / 2;
-
-    board->cells[snake_pos] = char_head;
-    board->snake[board->snake_head_idx] = snake_pos;
-
-    // decide tail position, currently always placed on the left
-    int tail_pos = snake_pos - 1;
-    board->cells[tail_pos] = char_tail;
-    board->snake[board->snake_head_idx - 1] = tail_pos;
-
-    // decide initial direction, currently always going to the right
-    int snake_direction = 1;
-    board->snake_direction = snake_direction;
-
-    // put bait
-    int bait_pos = rand() % (width * height);
-
-    // ensure bait is not near snake
-    while ((snake_pos - bait_pos) % width < 2 && (snake_pos - bait_pos) % width > -2) {
-        bait_pos = rand() % (width * height);
-    }
-    board->cells[bait_pos] = char_bait;
-
-    return board;
 }
 
+void update_screen_position(Renderer* renderer, const SnakeGame* game, const int x, const int y, const char c) {
+    // cells off the view aren't drawn, they are all on the board and the view shows them once it gets there
+    if (x < game->view_x || x >= game->view_x + game->view_width || y < game->view_y || y >= game->view_y + game->view_height)
+        return;
+    renderer_put(renderer, cell_columns * (x - game->view_x), y - game->view_y, c); // sent to the terminal with the rest of the frame in renderer_flush
+}
 
-void print_initial_board(Board* board) {
-    clear();
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            printw("%c  ", board->cells[indexOf(x, y)]);
+void print_view(Renderer* renderer, const SnakeGame* game) {
+    const Board* board = game->board;
+    for (int y = game->view_y; y < game->view_y + game->view_height; y++) {
+        for (int x = game->view_x; x < game->view_x + game->view_width; x++) {
+            update_screen_position(renderer, game, x, y, cell_chars[board_cell(board, board_index(board, x, y))]);
         }
-        printw("\n");
     }
-    refresh();
 }
 
-void update_screen_position(const int x, const int y, const char c) {
-    mvprintw(y, 3*x, "%c", c);
-    refresh();
+// the view start that keeps the head at least a quarter of the view from its edges, within the board
+static int follow(const int start, const int head, const int view, const int size) {
+    const int margin = view / 4;
+    int next = start;
+    if (head < next + margin)
+        next = head - margin;
+    if (head > next + view - 1 - margin)
+        next = head - view + 1 + margin;
+    if (next > size - view)
+        next = size - view;
+    return next < 0 ? 0 : next;
 }
 
-void spawn_new_bait(Board* board) {
-    int bait_pos = rand() % (width * height);
-    while (board->cells[bait_pos] != char_empty) {
-        bait_pos = rand() % (width * height);
-    }
-    board->cells[bait_pos] = char_bait;
-
-    int bait_x = bait_pos % width;
-    int bait_y = bait_pos / width;
-    update_screen_position(bait_x, bait_y, char_bait);
+/*  moves the view with the head. Returns 1 if it moved or changed size, then everything on it has to be drawn again,
+ *  which costs the view and never the board
+ */
+static int move_view(SnakeGame* game, const Renderer* renderer) {
+    const Board* b = game->board;
+    int width = renderer->cols / cell_columns;
+    int height = renderer->rows - 1; // the last row is for the status line
+    width = width < b->width ? width : b->width;
+    height = height < b->height ? height : b->height;
+
+    const int head = b->snake[b->snake_head_idx];
+    const int x = follow(game->view_x, head % b->width, width, b->width);
+    const int y = follow(game->view_y, head / b->width, height, b->height);
+    if (x == game->view_x && y == game->view_y && width == game->view_width && height == game->view_height)
+        return 0;
+    game->view_x = x;
+    game->view_y = y;
+    game->view_width = width;
+    game->view_height = height;
+    return 1;
 }
 
 int direction(const int ch) {
     switch (ch) {
-        case 'w': return 0;
-        case 'd': return 1;
-        case 's': return 2;
-        case 'a': return 3;
+        case 'w':
+        case KEY_UP: return snake_up;
+        case 'd':
+        case KEY_RIGHT: return snake_right;
+        case 's':
+        case KEY_DOWN: return snake_down;
+        case 'a':
+        case KEY_LEFT: return snake_left;
         default: return -1;
     }
 }
 
-void move_snake_and_update_screen(Board* b, const int direction) {
-    // if direction will be changed and new direction isn't opposite
-    if (direction != -1 && (direction - b->snake_direction + 4) % 4 != 2) {
-        b->snake_direction = direction;
-    }
+void* snake_init(const unsigned long seed) {
+    SnakeGame* game = malloc(sizeof(SnakeGame));
+    if (game == NULL)
+        return NULL;
 
-    const int next_x = (b->snake[b->snake_head_idx] % width) + (b->snake_direction == 1) - (b->snake_direction == 3);
-    const int next_y = (b->snake[b->snake_head_idx] / width) + (b->snake_direction == 2) - (b->snake_direction == 0);
-    const int next_head_pos = indexOf(next_x, next_y);
-    const bool bait_eaten = b->cells[next_head_pos] == char_bait;
+    int width, height;
+    board_size(&width, &height);
+    game->board = create_initial_board(width, height, seed);
+    if (game->board == NULL) {
+        free(game);
+        return NULL;
+    }
+    game->num_turns = 0;
+    game->won = 0;
+    game->view_x = 0;
+    game->view_y = 0;
+    game->view_width = 0;
+    game->view_height = 0;
+    return game;
+}
 
-    // collision checks, we don't end the game in collision, just wait for new input
-    if (next_x < 0 || next_x >= width || next_y < 0 || next_y >= height) // out of bounds
-        return;
-    if (b->cells[next_head_pos] == char_tail) // collision with tail
+// the snake advances only on ticks, a key just decides where a coming tick goes.
+// moving on every key made the game speed depend on how fast you type. Turns typed within one tick are queued,
+// so a quick up then left takes the corner instead of only going left
+void snake_input(void* state, const int key) {
+    SnakeGame* game = state;
+    const int d = direction(key);
+    if (d == -1 || game->num_turns == max_turns)
         return;
+    // a turn that changes nothing or reverses the one before it would be thrown away by snake_step anyway
+    const int last = game->num_turns > 0 ? game->turns[game->num_turns - 1] : game->board->snake_direction;
+    if (d != last && (d - last + 4) % 4 != 2)
+        game->turns[game->num_turns++] = d;
+}
 
-    const int prev_head_pos = b->snake[b->snake_head_idx];
-    b->cells[prev_head_pos] = char_tail;
-    update_screen_position(prev_head_pos % width, prev_head_pos / width, char_tail); // previous tail
+// the rules live in lib/snake_core.c
+int snake_tick(void* state) {
+    SnakeGame* game = state;
+    int d = -1;
+    if (game->num_turns > 0) {
+        d = game->turns[0];
+        memmove(game->turns, game->turns + 1, sizeof(int) * --game->num_turns);
+    }
+    game->won = (snake_step(game->board, d) & SNAKE_WON) != 0;
+    return game->won;
+}
 
-    b->snake_head_idx = (b->snake_head_idx + 1) % (width * height); // update the index of head in snake array
-    b->snake[b->snake_head_idx] = next_head_pos; // update the new head position
-    b->cells[next_head_pos] = char_head;
-    update_screen_position(next_x, next_y, char_head);
+// this only draws what the step changed, unless the view moved
+void snake_render(void* state, Renderer* renderer, const int full) {
+    SnakeGame* game = state;
+    Board* b = game->board;
 
-    // if a bait is eaten, just increase the snake length and spawn a new bait
-    if (bait_eaten) {
-        b->snake_length++;
-        spawn_new_bait(b);
+    if (move_view(game, renderer) || full) {
+        renderer_clear(renderer);
+        print_view(renderer, game);
     }
-    // if not, remove the last cell of tail
     else {
-        int tail_end_index = (b->snake_head_idx - b->snake_length + width*height) % (width * height);
-        int tail_end_position = b->snake[tail_end_index];
-        b->cells[tail_end_position] = char_empty;
-        int tail_x = tail_end_position % width;
-        int tail_y = tail_end_position / width;
-        update_screen_position(tail_x, tail_y, char_empty);
+        for (int i = 0; i < b->num_changes; i++) {
+            update_screen_position(renderer, game, b->changes[i].x, b->changes[i].y, b->changes[i].c);
+        }
     }
+    if (game->won)
+        renderer_print(renderer, 0, game->view_height, "You win! Press q to quit");
+    else if (game->view_width < b->width || game->view_height < b->height)
+        renderer_print(renderer, 0, game->view_height, "length %d   at %d,%d of %dx%d    ", b->snake_length,
+                       b->snake[b->snake_head_idx] % b->width, b->snake[b->snake_head_idx] / b->width, b->width, b->height);
 }
 
-
-void free_board(Board* b) {
-    if (b != NULL) {
-        free(b->cells);
-        free(b->snake);
-        free(b);
-    }
+void snake_shutdown(void* state) {
+    SnakeGame* game = state;
+    free_board(game->board);
+    free(game);
 }
 
-void cleanup() {
-    clear();
-    endwin();
-    free_board(board);
-    system("clear");
+uint64_t snake_state_hash(void* state) {
+    SnakeGame* game = state;
+    uint64_t hash = snake_hash(game->board);
+    for (int i = 0; i < game->num_turns; i++)
+        hash = hash_int(hash, game->turns[i]);
+    return hash;
 }
 
-void handle_sigint() {
-    cleanup();
-    exit(0);
-}
-void handle_sigterm() {
-    cleanup();
-    exit(0);
+// exported as is when built as a plugin, see lib/game_host.h
+int64_t snake_score(void* state) {
+    SnakeGame* game = state;
+    return game->board->snake_length;
 }
 
-int main() {
-    signal(SIGINT, handle_sigint);
-    signal(SIGTERM, handle_sigterm);
-
-    board = create_initial_board();
-
-    initscr();             // Start ncurses mode
-    cbreak();              // Disable line buffering
-    keypad(stdscr, TRUE);  // Enable arrow keys
-    noecho();              // Don't display typed characters
-    nodelay(stdscr, TRUE); // make getch non-blocking
-    curs_set(0);           // Hide the cursor
-
-    print_initial_board(board);
-
-    const int fps = 10; // also affects the speed of the snake, BE CAREFUL
-    const int frame_delay_ms = 1000 / fps; // delay between screen updates
-    const int input_poll_ms = 20;
-    int run = 1;
-
-    struct timespec last_frame_time;
-    clock_gettime(CLOCK_MONOTONIC, &last_frame_time);
-
-    char last_valid_input = '\0';
-    while (run) {
-
-        char ch = getch();
-        if (ch >= 'A' && ch <= 'Z')
-            ch += 32;
-        if (ch == 'q')
-            run = 0;
-
-        struct timespec current_time;
-        clock_gettime(CLOCK_MONOTONIC, &current_time);
-        long elapsed_time_ms = (current_time.tv_sec - last_frame_time.tv_sec) * 1000
-                             + (current_time.tv_nsec - last_frame_time.tv_nsec) / 1000000;
-
-        // if (direction(ch) != -1) {
-        //     last_valid_input = direction(ch);
-        // }
-        // I discarded this idea because updating the frame whenever I get a new input feels smoother, even if it can make the game faster
-
-        if (elapsed_time_ms >= frame_delay_ms || direction(ch) != -1) {
-            move_snake_and_update_screen(board, direction(ch));
-            last_frame_time = current_time;
-        }
-
-        napms(input_poll_ms); // sleep of ncurses used instead of sleep()
-    }
-
-    cleanup();
+const VgcGame vgc_game = {
+    .abi_version = VGC_GAME_ABI,
+    .name = "game_snake",
+    .tick_hz = 10, // also affects the speed of the snake, BE CAREFUL
+    .render_hz = 10, // nothing changes between ticks, so more than tick_hz only adds wakeups
+    .init = snake_init,
+    .input = snake_input,
+    .step = snake_tick,
+    .render = snake_render,
+    .shutdown = snake_shutdown,
+    .hash = snake_state_hash,
+    .score = snake_score,
+    .board_size = board_size,
+};
+
+// what the console's menu lists for this game, read from the file without running it
+VGC_GAME_INFO("Snake", "Eat the bait and grow, without running into a wall or yourself", "Virtual Game Console");
+
+#ifndef VGC_PLUGIN
+int main(int argc, char** argv) {
+    return run_standalone(&vgc_game, argc, argv);
 }
+#endif
 
 
 
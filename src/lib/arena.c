@@ -0,0 +1,39 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+Arena* create_arena(const size_t capacity) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (arena == NULL)
+        return NULL;
+
+    // only reserved, a page costs memory once something is allocated on it
+    arena->base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena->base == MAP_FAILED) {
+        free(arena);
+        return NULL;
+    }
+    arena->used = 0;
+    arena->capacity = capacity;
+    return arena;
+}
+
+void free_arena(Arena* arena) {
+    if (arena != NULL) {
+        munmap(arena->base, arena->capacity);
+        free(arena);
+    }
+}
+
+void* arena_alloc(Arena* arena, const size_t size) {
+    const size_t start = (arena->used + arena_alignment - 1) & ~(size_t) (arena_alignment - 1);
+    if (start + size > arena->capacity)
+        return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef VGC_ARENA_H
+#define VGC_ARENA_H
+
+#include <stddef.h>
+
+/*  Bump allocator for game states that are created and thrown away together (the batch simulator's chunks).
+ *  Everything lands next to each other in one mapping, cache line aligned, and goes away with one arena_reset().
+ *  The pages are only touched by whoever allocates from the arena, so a worker's games live in its own memory.
+ */
+
+#define arena_alignment 64
+
+typedef struct {
+    char* base;
+    size_t used;
+    size_t capacity;
+} Arena;
+
+Arena* create_arena(size_t capacity);
+void free_arena(Arena* arena);
+
+// NULL once the arena is full, the memory is not zeroed after a reset
+void* arena_alloc(Arena* arena, size_t size);
+void arena_reset(Arena* arena);
+
+#endif
@@ -0,0 +1,317 @@
+#include "blackjack_core.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+const uint8_t card_values[13] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10};
+
+void shoe_init(Shoe* shoe, int decks, const uint64_t seed) {
+    if (decks < 1)
+        decks = 1;
+    if (decks > bj_max_decks)
+        decks = bj_max_decks;
+    memset(shoe, 0, sizeof(Shoe));
+    shoe->num_cards = decks * 52;
+    for (int i = 0; i < shoe->num_cards; i++)
+        shoe->cards[i] = i % 52;
+    shoe->cut = (int) (shoe->num_cards * bj_penetration);
+    rng_seed(&shoe->rng, seed);
+    shoe_shuffle(shoe);
+}
+
+// Fisher-Yates, in place, one rng call per card
+void shoe_shuffle(Shoe* shoe) {
+    for (int i = shoe->num_cards - 1; i > 0; i--) {
+        const int j = rng_below(&shoe->rng, i + 1);
+        const uint8_t card = shoe->cards[i];
+        shoe->cards[i] = shoe->cards[j];
+        shoe->cards[j] = card;
+    }
+    shoe->next = 0;
+    shoe->shuffles++;
+}
+
+static uint8_t shoe_draw(Shoe* shoe) {
+    // only a long round on a single deck gets here, the cards on the table stay out of the reshuffle in a real
+    // casino but the odds barely notice
+    if (shoe->next == shoe->num_cards)
+        shoe_shuffle(shoe);
+    return shoe->cards[shoe->next++];
+}
+
+static void hand_add(Hand* h, const uint8_t card) {
+    if (h->count < bj_max_cards)
+        h->cards[h->count++] = card;
+    h->hard += card_value(card);
+    h->aces += card_rank(card) == 0;
+}
+
+static void hand_start(Hand* h) {
+    memset(h, 0, sizeof(Hand));
+    h->bet = 1;
+}
+
+void blackjack_setup(BlackjackTable* t, const int decks, const uint64_t seed) {
+    memset(t, 0, sizeof(BlackjackTable)); // no padding garbage, the whole struct goes into the state hash
+    shoe_init(&t->shoe, decks, seed);
+}
+
+static void settle(BlackjackTable* t) {
+    const int dealer_total = hand_total(&t->dealer);
+    const int dealer_blackjack = hand_is_blackjack(&t->dealer);
+    t->dealer_busted = dealer_total > 21;
+    t->net = 0;
+    for (int i = 0; i < t->num_hands; i++) {
+        const Hand* h = &t->hands[i];
+        const int total = hand_total(h);
+        int result;
+        if (hand_is_blackjack(h))
+            result = dealer_blackjack ? 0 : 3;
+        else if (total > 21 || dealer_blackjack)
+            result = -2;
+        else if (dealer_total > 21 || total > dealer_total)
+            result = 2;
+        else
+            result = total == dealer_total ? 0 : -2;
+        t->results[i] = result * h->bet;
+        t->net += t->results[i];
+    }
+    t->in_round = 0;
+}
+
+static void finish_round(BlackjackTable* t) {
+    int all_busted = 1;
+    for (int i = 0; i < t->num_hands; i++)
+        all_busted &= hand_total(&t->hands[i]) > 21;
+    // soft 17 stands
+    while (!all_busted && hand_total(&t->dealer) < 17)
+        hand_add(&t->dealer, shoe_draw(&t->shoe));
+    settle(t);
+}
+
+// moves on to the next hand that still needs a decision, or ends the round
+static void next_hand(BlackjackTable* t) {
+    while (t->current < t->num_hands) {
+        Hand* h = &t->hands[t->current];
+        if (hand_total(h) >= 21)
+            h->done = 1; // nothing to decide at 21 or above
+        if (!h->done)
+            return;
+        t->current++;
+    }
+    finish_round(t);
+}
+
+void blackjack_deal(BlackjackTable* t) {
+    if (t->shoe.next > t->shoe.cut)
+        shoe_shuffle(&t->shoe);
+
+    hand_start(&t->dealer);
+    hand_start(&t->hands[0]);
+    t->num_hands = 1;
+    t->current = 0;
+    t->in_round = 1;
+    t->dealer_busted = 0;
+    memset(t->results, 0, sizeof(t->results));
+
+    hand_add(&t->hands[0], shoe_draw(&t->shoe));
+    hand_add(&t->dealer, shoe_draw(&t->shoe));
+    hand_add(&t->hands[0], shoe_draw(&t->shoe));
+    hand_add(&t->dealer, shoe_draw(&t->shoe));
+
+    // the dealer peeks, a blackjack on either side ends the round before anyone acts
+    if (hand_is_blackjack(&t->dealer) || hand_is_blackjack(&t->hands[0]))
+        settle(t);
+}
+
+int blackjack_allowed(const BlackjackTable* t) {
+    if (!t->in_round)
+        return 0;
+    const Hand* h = &t->hands[t->current];
+    const int split_ace = h->from_split && card_rank(h->cards[0]) == 0;
+    const int two_cards = h->count == 2 && !split_ace;
+    const int pair = two_cards && card_value(h->cards[0]) == card_value(h->cards[1]) && t->num_hands < bj_max_hands;
+    return BJ_CAN(BJ_HIT) | BJ_CAN(BJ_STAND) | two_cards * BJ_CAN(BJ_DOUBLE) | pair * BJ_CAN(BJ_SPLIT);
+}
+
+void blackjack_act(BlackjackTable* t, const int action) {
+    if (action > BJ_SPLIT || !(blackjack_allowed(t) & BJ_CAN(action)))
+        return;
+
+    Hand* h = &t->hands[t->current];
+    switch (action) {
+        case BJ_HIT:
+            hand_add(h, shoe_draw(&t->shoe));
+            break;
+        case BJ_STAND:
+            h->done = 1;
+            break;
+        case BJ_DOUBLE:
+            h->bet = 2;
+            hand_add(h, shoe_draw(&t->shoe));
+            h->done = 1;
+            break;
+        case BJ_SPLIT: {
+            Hand* second = &t->hands[t->num_hands++];
+            const uint8_t first_card = h->cards[0];
+            const uint8_t second_card = h->cards[1];
+            hand_start(h);
+            hand_start(second);
+            h->from_split = second->from_split = 1;
+            hand_add(h, first_card);
+            hand_add(second, second_card);
+            hand_add(h, shoe_draw(&t->shoe));
+            hand_add(second, shoe_draw(&t->shoe));
+            // split aces get one card each and no say
+            if (card_rank(first_card) == 0)
+                h->done = second->done = 1;
+            break;
+        }
+    }
+    next_hand(t);
+}
+
+/*  Strategy tables, one line per hand: "hard <total>:", "soft <total>:" or "pair <card value>:" (1 for aces),
+ *  then the action against a dealer 2, 3, ... 10, ace: H hit, S stand, D double or hit, Ds double or stand, P split.
+ *  Hands without a line hit below 17 and stand from 17 on, pairs without a line are played by their total.
+ */
+
+static const char* basic_strategy[] = {
+    // multi-deck, dealer stands on soft 17, double after split
+    //        2  3  4  5  6  7  8  9  10 A
+    "hard 9:  H  D  D  D  D  H  H  H  H  H",
+    "hard 10: D  D  D  D  D  D  D  D  H  H",
+    "hard 11: D  D  D  D  D  D  D  D  D  H",
+    "hard 12: H  H  S  S  S  H  H  H  H  H",
+    "hard 13: S  S  S  S  S  H  H  H  H  H",
+    "hard 14: S  S  S  S  S  H  H  H  H  H",
+    "hard 15: S  S  S  S  S  H  H  H  H  H",
+    "hard 16: S  S  S  S  S  H  H  H  H  H",
+    "soft 13: H  H  H  D  D  H  H  H  H  H",
+    "soft 14: H  H  H  D  D  H  H  H  H  H",
+    "soft 15: H  H  D  D  D  H  H  H  H  H",
+    "soft 16: H  H  D  D  D  H  H  H  H  H",
+    "soft 17: H  D  D  D  D  H  H  H  H  H",
+    "soft 18: S  Ds Ds Ds Ds S  S  H  H  H",
+    "pair 1:  P  P  P  P  P  P  P  P  P  P",
+    "pair 2:  P  P  P  P  P  P  H  H  H  H",
+    "pair 3:  P  P  P  P  P  P  H  H  H  H",
+    "pair 4:  H  H  H  P  P  H  H  H  H  H",
+    "pair 6:  P  P  P  P  P  H  H  H  H  H",
+    "pair 7:  P  P  P  P  P  P  H  H  H  H",
+    "pair 8:  P  P  P  P  P  P  P  P  P  P",
+    "pair 9:  P  P  P  P  P  S  P  P  S  S",
+    NULL,
+};
+
+static const char* dealer_strategy[] = {NULL}; // hit below 17, never double or split
+
+static const char* never_bust_strategy[] = {
+    "hard 12: S  S  S  S  S  S  S  S  S  S",
+    "hard 13: S  S  S  S  S  S  S  S  S  S",
+    "hard 14: S  S  S  S  S  S  S  S  S  S",
+    "hard 15: S  S  S  S  S  S  S  S  S  S",
+    "hard 16: S  S  S  S  S  S  S  S  S  S",
+    NULL,
+};
+
+static int parse_action(const char* token) {
+    if (strcmp(token, "H") == 0)
+        return BJ_HIT;
+    if (strcmp(token, "S") == 0)
+        return BJ_STAND;
+    if (strcmp(token, "D") == 0)
+        return BJ_DOUBLE;
+    if (strcmp(token, "Ds") == 0)
+        return BJ_DOUBLE_OR_STAND;
+    if (strcmp(token, "P") == 0)
+        return BJ_SPLIT;
+    return -1;
+}
+
+// returns -1 if the line is wrong, comments and empty lines are fine
+static int parse_strategy_line(Strategy* s, const char* line) {
+    char kind[8];
+    int value;
+    int used;
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (*line == '\0' || *line == '\n' || *line == '#')
+        return 0;
+    if (sscanf(line, "%7s %d:%n", kind, &value, &used) != 2)
+        return -1;
+
+    uint8_t* row;
+    if (strcmp(kind, "hard") == 0 && value >= 4 && value <= 21)
+        row = s->hard[value];
+    else if (strcmp(kind, "soft") == 0 && value >= 12 && value <= 21)
+        row = s->soft[value];
+    else if (strcmp(kind, "pair") == 0 && value >= 1 && value <= 10)
+        row = s->pair[value - 1];
+    else
+        return -1;
+
+    line += used;
+    for (int column = 0; column < 10; column++) {
+        char token[4];
+        if (sscanf(line, "%3s%n", token, &used) != 1 || parse_action(token) == -1)
+            return -1;
+        row[column] = parse_action(token);
+        line += used;
+    }
+    return 0;
+}
+
+int load_strategy(Strategy* s, const char* name) {
+    for (int total = 0; total < 22; total++) {
+        memset(s->hard[total], total < 17 ? BJ_HIT : BJ_STAND, 10);
+        memset(s->soft[total], total < 17 ? BJ_HIT : BJ_STAND, 10);
+    }
+    memset(s->pair, BJ_NONE, sizeof(s->pair));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+
+    const char** lines = strcmp(name, "basic") == 0        ? basic_strategy
+                         : strcmp(name, "dealer") == 0     ? dealer_strategy
+                         : strcmp(name, "never-bust") == 0 ? never_bust_strategy
+                                                           : NULL;
+    if (lines != NULL) {
+        for (int i = 0; lines[i] != NULL; i++)
+            parse_strategy_line(s, lines[i]);
+        return 0;
+    }
+
+    FILE* file = fopen(name, "r");
+    if (file == NULL)
+        return -1;
+    char line[256];
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), file) != NULL)
+        result = parse_strategy_line(s, line);
+    fclose(file);
+    if (result == -1)
+        errno = EINVAL;
+    return result;
+}
+
+int strategy_action(const Strategy* s, const BlackjackTable* t) {
+    const Hand* h = &t->hands[t->current];
+    const int allowed = blackjack_allowed(t);
+    const int up_value = card_value(t->dealer.cards[0]);
+    const int column = up_value == 1 ? 9 : up_value - 2;
+
+    int action = BJ_NONE;
+    if (allowed & BJ_CAN(BJ_SPLIT))
+        action = s->pair[card_value(h->cards[0]) - 1][column];
+    if (action == BJ_NONE)
+        action = hand_is_soft(h) ? s->soft[hand_total(h)][column] : s->hard[hand_total(h)][column];
+
+    if (action == BJ_DOUBLE || action == BJ_DOUBLE_OR_STAND) {
+        if (allowed & BJ_CAN(BJ_DOUBLE))
+            return BJ_DOUBLE;
+        return action == BJ_DOUBLE ? BJ_HIT : BJ_STAND;
+    }
+    if (action == BJ_SPLIT && !(allowed & BJ_CAN(BJ_SPLIT)))
+        return BJ_HIT; // a split line for a hand that can't split anymore
+    return action;
+}
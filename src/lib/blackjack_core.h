@@ -0,0 +1,110 @@
+#ifndef VGC_BLACKJACK_CORE_H
+#define VGC_BLACKJACK_CORE_H
+
+#include <stdint.h>
+
+#include "rng.h"
+
+/*  Blackjack rules without any terminal code, shared by game_blackjack and its --evaluate mode.
+ *  A card is one byte, rank << 2 | suit, and the whole shoe is an inline array shuffled in place with Fisher-Yates, so
+ *  a table is one flat struct with no pointers: it can be hashed with hash_bytes and copied per thread.
+ *  A hand keeps its hard total (aces as 1) and its ace count, the best total is then one compare and no loop.
+ *  Rules: dealer stands on soft 17 and peeks for blackjack, blackjack pays 3:2, double on any first two cards and
+ *  after a split, split up to bj_max_hands hands, split aces get one card each, no surrender.
+ */
+
+#define bj_max_decks 8
+#define bj_max_hands 4
+#define bj_max_cards 12 // A A A A 2 2 2 2 3 3 3 is 21 in 11 cards
+#define bj_penetration 0.75 // of the shoe dealt before it is shuffled again
+
+// rank 0 is the ace, 9 to 12 are ten, jack, queen and king
+#define card_rank(card) ((card) >> 2)
+#define card_suit(card) ((card) & 3)
+
+// actions, what the player does with the current hand
+#define BJ_HIT    0
+#define BJ_STAND  1
+#define BJ_DOUBLE 2 // in a strategy table: double if allowed, hit otherwise
+#define BJ_SPLIT  3
+#define BJ_DOUBLE_OR_STAND 4 // only in strategy tables: double if allowed, stand otherwise
+#define BJ_NONE   255 // a pair the strategy doesn't split, played by its total
+
+#define BJ_CAN(action) (1 << (action))
+
+extern const uint8_t card_values[13]; // 1 for the ace, 10 for ten to king
+
+static inline int card_value(const uint8_t card) {
+    return card_values[card_rank(card)];
+}
+
+typedef struct {
+    uint8_t cards[bj_max_decks * 52];
+    int num_cards;
+    int next; // the card dealt next
+    int cut;  // a round that starts past this card shuffles first
+    long shuffles;
+    Rng rng;
+} Shoe;
+
+typedef struct {
+    uint8_t cards[bj_max_cards];
+    uint8_t count;
+    uint8_t hard; // total with aces as 1
+    uint8_t aces;
+    uint8_t bet;  // 1, 2 once doubled
+    uint8_t done;
+    uint8_t from_split;
+} Hand;
+
+// an ace counts 11 if that doesn't bust the hand, and two aces never both do
+static inline int hand_is_soft(const Hand* h) {
+    return (h->aces != 0) & (h->hard <= 11);
+}
+
+static inline int hand_total(const Hand* h) {
+    return h->hard + hand_is_soft(h) * 10;
+}
+
+static inline int hand_is_blackjack(const Hand* h) {
+    return (h->count == 2) & (h->hard == 11) & (h->aces != 0) & !h->from_split;
+}
+
+typedef struct {
+    Shoe shoe;
+    Hand dealer;
+    Hand hands[bj_max_hands];
+    int num_hands;
+    int current;   // the hand the player acts on
+    int in_round;  // 0 once the round is settled, deal the next one with blackjack_deal
+    int results[bj_max_hands]; // of the settled round, in half bets: 3 for a blackjack, -4 for a lost double
+    int net;       // sum of the results
+    int dealer_busted;
+} BlackjackTable;
+
+// the strategy's action by hand total (or pair value - 1) and dealer up card column (2 to 10, then the ace)
+typedef struct {
+    char name[32];
+    uint8_t hard[22][10];
+    uint8_t soft[22][10];
+    uint8_t pair[10][10];
+} Strategy;
+
+void shoe_init(Shoe* shoe, int decks, uint64_t seed);
+void shoe_shuffle(Shoe* shoe);
+
+void blackjack_setup(BlackjackTable* t, int decks, uint64_t seed);
+// starts a round with a bet of 1, settles it right away if someone has a blackjack
+void blackjack_deal(BlackjackTable* t);
+// BJ_CAN() bits of the actions the current hand allows, 0 outside a round
+int blackjack_allowed(const BlackjackTable* t);
+// does nothing if the action isn't allowed. Plays the dealer and settles once every hand is done
+void blackjack_act(BlackjackTable* t, int action);
+
+// fills s from a built-in strategy (basic, dealer, never-bust) or a file with the same lines, see blackjack_core.c.
+// Returns -1 with errno set if the file can't be read, EINVAL if a line is wrong
+int load_strategy(Strategy* s, const char* name);
+// what the strategy does with the current hand, always one the hand allows
+int strategy_action(const Strategy* s, const BlackjackTable* t);
+
+#endif
@@ -0,0 +1,167 @@
+#define _GNU_SOURCE // memfd_create and the file seals
+#include "bundle.h"
+#include "hash.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+uint64_t bundle_checksum(const void* data, const size_t size) {
+    return hash_bytes(hash_init, data, size);
+}
+
+static int valid_table(const Bundle* bundle) {
+    const BundleHeader* header = bundle->header;
+    if (bundle->size < sizeof(BundleHeader)
+        || memcmp(header->magic, bundle_magic, sizeof(header->magic)) != 0
+        || header->version != bundle_version)
+        return 0;
+
+    const size_t table_size = sizeof(BundleEntry) * (size_t) header->count;
+    if (table_size > bundle->size - sizeof(BundleHeader)
+        || bundle_checksum(bundle->entries, table_size) != header->table_checksum)
+        return 0;
+
+    for (uint32_t i = 0; i < header->count; i++) {
+        const BundleEntry* entry = &bundle->entries[i];
+        if (memchr(entry->name, '\0', sizeof(entry->name)) == NULL
+            || entry->offset % bundle_align != 0
+            || entry->offset > bundle->size || entry->size > bundle->size - entry->offset)
+            return 0;
+        // bundle_find does a binary search
+        if (i > 0 && strcmp(bundle->entries[i - 1].name, entry->name) >= 0)
+            return 0;
+    }
+    return 1;
+}
+
+Bundle* open_bundle(const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(BundleHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (data == MAP_FAILED)
+        return NULL;
+
+    Bundle* bundle = malloc(sizeof(Bundle));
+    if (bundle == NULL) {
+        munmap(data, st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    bundle->data = data;
+    bundle->size = st.st_size;
+    bundle->header = data;
+    bundle->entries = (const BundleEntry*) (bundle->data + sizeof(BundleHeader));
+    bundle->game_fds = NULL;
+
+    if (!valid_table(bundle)) {
+        munmap(data, st.st_size);
+        free(bundle);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    bundle->game_fds = malloc(sizeof(int) * (bundle->header->count > 0 ? bundle->header->count : 1));
+    if (bundle->game_fds == NULL) {
+        munmap(data, st.st_size);
+        free(bundle);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (uint32_t i = 0; i < bundle->header->count; i++)
+        bundle->game_fds[i] = -1;
+    return bundle;
+}
+
+void free_bundle(Bundle* bundle) {
+    if (bundle != NULL) {
+        for (uint32_t i = 0; i < bundle->header->count; i++) {
+            if (bundle->game_fds[i] != -1)
+                close(bundle->game_fds[i]);
+        }
+        free(bundle->game_fds);
+        munmap((void*) bundle->data, bundle->size);
+        free(bundle);
+    }
+}
+
+int bundle_find(const Bundle* bundle, const char* name) {
+    int low = 0;
+    int high = (int) bundle->header->count - 1;
+    while (low <= high) {
+        const int mid = (low + high) / 2;
+        const int cmp = strcmp(bundle->entries[mid].name, name);
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return -1;
+}
+
+static int write_all(const int fd, const unsigned char* p, size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(fd, p, size);
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/*  The bytes are copied into a memfd and sealed, so the game that runs is exactly what was checked even if the
+ *  bundle file is replaced under us. exec refuses a file that is open for writing (ETXTBSY), so the writable fd is
+ *  swapped for a read-only one opened through /proc.
+ */
+int bundle_game_fd(Bundle* bundle, const int idx) {
+    if (idx < 0 || idx >= (int) bundle->header->count) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (bundle->game_fds[idx] != -1)
+        return bundle->game_fds[idx];
+
+    const BundleEntry* entry = &bundle->entries[idx];
+    const unsigned char* bytes = bundle->data + entry->offset;
+    if (bundle_checksum(bytes, entry->size) != entry->checksum) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    const int fd = memfd_create(entry->name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1)
+        return -1;
+    if (write_all(fd, bytes, entry->size) == -1
+        || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    const int read_only = open(path, O_RDONLY | O_CLOEXEC);
+    close(fd);
+    if (read_only == -1)
+        return -1;
+
+    bundle->game_fds[idx] = read_only;
+    return read_only;
+}
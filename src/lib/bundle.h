@@ -0,0 +1,60 @@
+#ifndef VGC_BUNDLE_H
+#define VGC_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  A read-only game bundle, one file instead of a disk image:
+ *
+ *      BundleHeader | BundleEntry[count] sorted by name | padding | game 0 | padding | game 1 | ...
+ *
+ *  Every game starts on a bundle_align boundary, so it can be mapped or copied page by page straight from the file.
+ *  The header checksums the entry table and every entry checksums its game. Opening a bundle is one mmap and a check
+ *  of the table, a game's own checksum is only verified the first time it is run.
+ *  The games are run from a sealed memfd holding their bytes, so nothing has to be mounted or written to disk.
+ */
+
+#define bundle_magic "VGCBUNDL"
+#define bundle_version 1
+#define bundle_align 4096
+#define bundle_name_size 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t table_checksum; // of the count entries right after the header
+} BundleHeader;
+
+typedef struct {
+    char name[bundle_name_size];
+    uint64_t offset; // from the start of the bundle, a multiple of bundle_align
+    uint64_t size;
+    int64_t mtime_ns; // of the file that was packed
+    uint64_t checksum; // of the size bytes at offset
+} BundleEntry;
+
+typedef struct {
+    const unsigned char* data; // the whole file, mapped read-only
+    size_t size;
+
+    const BundleHeader* header;
+    const BundleEntry* entries;
+
+    int* game_fds; // memfd per entry once it has been run, -1 before
+} Bundle;
+
+uint64_t bundle_checksum(const void* data, size_t size);
+
+// maps the bundle and checks its header and table, NULL with errno set if it isn't a valid bundle
+Bundle* open_bundle(const char* path);
+void free_bundle(Bundle* bundle);
+
+// index of the entry with this name, -1 if it isn't there
+int bundle_find(const Bundle* bundle, const char* name);
+
+// a sealed, read-only memfd with the game's bytes, exec or dlopen it through /proc/self/fd/<fd>. Created on the first
+// call after checking the game's checksum, -1 with errno set on failure (EBADMSG if the checksum doesn't match)
+int bundle_game_fd(Bundle* bundle, int idx);
+
+#endif
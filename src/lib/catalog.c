@@ -0,0 +1,336 @@
+#include "catalog.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define index_magic "VGCCATLG"
+#define index_version 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    int64_t dir_mtime_ns; // the directory mtime the entries are valid for
+} IndexHeader;
+
+int is_game_name(const char* filename) {
+    // check if it starts with "game_"
+    return strncmp(filename, "game_", 5) == 0 && strlen(filename) < max_game_name;
+}
+
+static long long mtime_ns(const struct stat* st) {
+    return (long long) st->st_mtim.tv_sec * 1000000000ll + st->st_mtim.tv_nsec;
+}
+
+int catalog_find(const Catalog* catalog, const char* name) {
+    int low = 0;
+    int high = catalog->num_entries - 1;
+    while (low <= high) {
+        const int mid = (low + high) / 2;
+        const int cmp = strcmp(catalog->entries[mid].name, name);
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return -1;
+}
+
+int catalog_game_info(const Catalog* catalog, const int idx, GameInfo* info) {
+    const char* name = catalog->entries[idx].name;
+    if (catalog->bundle == NULL)
+        return game_info_read(catalog->dir_fd, name, info);
+
+    // the bundle is mapped already, parsing touches the pages of the game's headers and nothing else
+    const Bundle* bundle = catalog->bundle;
+    const int i = bundle_find(bundle, name);
+    if (i == -1) {
+        memset(info, 0, sizeof(GameInfo));
+        return -1;
+    }
+    return game_info_parse(bundle->data + bundle->entries[i].offset, bundle->entries[i].size, info);
+}
+
+// keeps the entries sorted, replaces an entry with the same name. Returns -1 if there was no room for a new one
+static int put_entry(Catalog* catalog, const CatalogEntry* entry) {
+    int i = 0;
+    while (i < catalog->num_entries && strcmp(catalog->entries[i].name, entry->name) < 0)
+        i++;
+
+    if (i < catalog->num_entries && strcmp(catalog->entries[i].name, entry->name) == 0) {
+        catalog->entries[i] = *entry;
+        return 0;
+    }
+
+    if (catalog->num_entries == catalog->capacity) {
+        const int capacity = catalog->capacity == 0 ? 16 : catalog->capacity * 2;
+        CatalogEntry* entries = realloc(catalog->entries, sizeof(CatalogEntry) * capacity);
+        if (entries == NULL)
+            return -1;
+        catalog->entries = entries;
+        catalog->capacity = capacity;
+    }
+    memmove(&catalog->entries[i + 1], &catalog->entries[i], sizeof(CatalogEntry) * (catalog->num_entries - i));
+    catalog->entries[i] = *entry;
+    catalog->num_entries++;
+    return 0;
+}
+
+static void remove_entry(Catalog* catalog, const int i) {
+    memmove(&catalog->entries[i], &catalog->entries[i + 1], sizeof(CatalogEntry) * (catalog->num_entries - i - 1));
+    catalog->num_entries--;
+}
+
+// the entry for a game_ file as it is now, returns -1 if it is gone or not a game anymore
+static int stat_entry(const Catalog* catalog, const char* name, CatalogEntry* entry) {
+    struct stat st;
+    // check if it is a regular file and has execute permission
+    if (fstatat(catalog->dir_fd, name, &st, 0) == -1 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IXUSR))
+        return -1;
+
+    memset(entry, 0, sizeof(CatalogEntry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->size = st.st_size;
+    entry->mtime_ns = mtime_ns(&st);
+    entry->executable = 1;
+    return 0;
+}
+
+// stats one game_ file and adds, updates or removes its entry. Returns 1 if the list changed
+static int refresh_entry(Catalog* catalog, const char* name) {
+    const int existing = catalog_find(catalog, name);
+
+    CatalogEntry entry;
+    if (stat_entry(catalog, name, &entry) == -1) {
+        if (existing == -1)
+            return 0;
+        remove_entry(catalog, existing);
+        return 1;
+    }
+
+    if (existing != -1 && memcmp(&catalog->entries[existing], &entry, sizeof(entry)) == 0)
+        return 0;
+    return put_entry(catalog, &entry) == 0; // out of memory the game just isn't listed
+}
+
+static void scan_directory(Catalog* catalog) {
+    catalog->num_entries = 0;
+    catalog->from_index = 0;
+
+    DIR* dir = fdopendir(dup(catalog->dir_fd));
+    if (dir == NULL)
+        return;
+
+    // one pass, and only the game_ entries get stat'ed
+    struct dirent* dir_entry;
+    while ((dir_entry = readdir(dir)) != NULL) {
+        if (is_game_name(dir_entry->d_name))
+            refresh_entry(catalog, dir_entry->d_name);
+    }
+    closedir(dir);
+}
+
+static int read_index(Catalog* catalog, const long long dir_mtime) {
+    const int fd = openat(catalog->dir_fd, catalog_index_name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    IndexHeader header;
+    int valid = read(fd, &header, sizeof(header)) == sizeof(header)
+                && memcmp(header.magic, index_magic, sizeof(header.magic)) == 0
+                && header.version == index_version
+                && header.dir_mtime_ns == dir_mtime;
+
+    if (valid) {
+        const int capacity = header.count > 0 ? header.count : 1;
+        CatalogEntry* entries = realloc(catalog->entries, sizeof(CatalogEntry) * capacity);
+        if (entries != NULL) {
+            catalog->entries = entries;
+            catalog->capacity = capacity;
+        }
+        const ssize_t size = sizeof(CatalogEntry) * header.count;
+        valid = entries != NULL && read(fd, catalog->entries, size) == size;
+    }
+    close(fd);
+
+    // a game changed in place keeps the directory mtime, so every entry is checked against its file as well
+    for (uint32_t i = 0; valid && i < header.count; i++) {
+        CatalogEntry entry;
+        valid = stat_entry(catalog, catalog->entries[i].name, &entry) == 0
+                && entry.size == catalog->entries[i].size && entry.mtime_ns == catalog->entries[i].mtime_ns;
+    }
+    catalog->num_entries = valid ? header.count : 0;
+    return valid;
+}
+
+static long long dir_mtime(const Catalog* catalog) {
+    struct stat dir_stat;
+    return fstat(catalog->dir_fd, &dir_stat) == 0 ? mtime_ns(&dir_stat) : -1;
+}
+
+/*  written in place, which doesn't touch the directory the way creating or renaming a file does. The header says the
+ *  index is valid for no directory state while the entries are written, and gets the mtime the entries were read at
+ *  last, only if the directory still has it: otherwise something changed in it since, and the index would miss that.
+ *  Returns -1 in that case. A read-only image just doesn't get an index
+ */
+static int write_index(const Catalog* catalog, const long long read_mtime) {
+    const int fd = openat(catalog->dir_fd, catalog_index_name, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return 0;
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, index_magic, sizeof(header.magic));
+    header.version = index_version;
+    header.count = catalog->num_entries;
+    header.dir_mtime_ns = -1; // not valid for any directory state until the entries are written
+
+    const ssize_t size = sizeof(CatalogEntry) * catalog->num_entries;
+    const int written = pwrite(fd, &header, sizeof(header), 0) == sizeof(header)
+                        && pwrite(fd, catalog->entries, size, sizeof(header)) == size
+                        && ftruncate(fd, sizeof(header) + size) == 0;
+    const int unchanged = dir_mtime(catalog) == read_mtime;
+    if (written && unchanged) {
+        header.dir_mtime_ns = read_mtime;
+        pwrite(fd, &header, sizeof(header), 0);
+    }
+    close(fd);
+    return written && !unchanged ? -1 : 0;
+}
+
+Catalog* load_catalog(const char* dir) {
+    Catalog* catalog = malloc(sizeof(Catalog));
+    if (catalog == NULL)
+        return NULL;
+
+    memset(catalog, 0, sizeof(Catalog));
+    catalog->inotify_fd = -1;
+    catalog->dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (catalog->dir_fd == -1) {
+        free(catalog);
+        return NULL;
+    }
+
+    if (read_index(catalog, dir_mtime(catalog))) {
+        catalog->from_index = 1;
+        return catalog;
+    }
+
+    // the index file exists before the mtime is taken, so creating it isn't taken for a change during the scan
+    const int fd = openat(catalog->dir_fd, catalog_index_name, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd != -1)
+        close(fd);
+    // a game added or removed while the directory was read shows up as a newer mtime, then it is read again
+    for (int tries = 0; tries < 3; tries++) {
+        const long long read_mtime = dir_mtime(catalog);
+        scan_directory(catalog);
+        if (write_index(catalog, read_mtime) == 0)
+            break;
+    }
+    return catalog;
+}
+
+Catalog* load_catalog_bundle(const char* path) {
+    Bundle* bundle = open_bundle(path);
+    if (bundle == NULL)
+        return NULL;
+
+    Catalog* catalog = calloc(1, sizeof(Catalog));
+    if (catalog == NULL) {
+        free_bundle(bundle);
+        errno = ENOMEM;
+        return NULL;
+    }
+    catalog->dir_fd = -1;
+    catalog->inotify_fd = -1;
+    catalog->bundle = bundle;
+
+    // the bundle table is sorted already, put_entry only ever appends
+    for (uint32_t i = 0; i < bundle->header->count; i++) {
+        const BundleEntry* bundle_entry = &bundle->entries[i];
+        if (!is_game_name(bundle_entry->name))
+            continue;
+
+        CatalogEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        snprintf(entry.name, sizeof(entry.name), "%s", bundle_entry->name);
+        entry.size = bundle_entry->size;
+        entry.mtime_ns = bundle_entry->mtime_ns;
+        entry.executable = 1;
+        if (put_entry(catalog, &entry) == -1) {
+            free_catalog(catalog);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return catalog;
+}
+
+void free_catalog(Catalog* catalog) {
+    if (catalog != NULL) {
+        if (catalog->inotify_fd != -1)
+            close(catalog->inotify_fd);
+        if (catalog->dir_fd != -1)
+            close(catalog->dir_fd);
+        free_bundle(catalog->bundle);
+        free(catalog->entries);
+        free(catalog);
+    }
+}
+
+int catalog_watch(Catalog* catalog) {
+    if (catalog->bundle != NULL)
+        return -1; // read-only, nothing to watch
+
+    catalog->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (catalog->inotify_fd == -1)
+        return -1;
+
+    // inotify wants a path, the directory fd is reachable through /proc
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", catalog->dir_fd);
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE;
+    if (inotify_add_watch(catalog->inotify_fd, path, mask) == -1) {
+        close(catalog->inotify_fd);
+        catalog->inotify_fd = -1;
+    }
+    return catalog->inotify_fd;
+}
+
+int catalog_handle_events(Catalog* catalog) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    int rescan = 0;
+
+    ssize_t n;
+    while ((n = read(catalog->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + n;) {
+            const struct inotify_event* event = (const struct inotify_event*) p;
+            if (event->mask & IN_Q_OVERFLOW)
+                rescan = 1; // events were lost, the only way to be sure is to read the directory again
+            else if (event->len > 0 && is_game_name(event->name))
+                changed |= refresh_entry(catalog, event->name);
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // a change after this has an event waiting, which writes the index again
+    const long long read_mtime = dir_mtime(catalog);
+    if (rescan) {
+        scan_directory(catalog);
+        changed = 1;
+    }
+    if (changed)
+        write_index(catalog, read_mtime);
+    return changed;
+}
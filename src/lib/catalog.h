@@ -0,0 +1,59 @@
+#ifndef VGC_CATALOG_H
+#define VGC_CATALOG_H
+
+/*  The list of games in a directory (the mounted image), kept in an index file inside that directory.
+ *  At start-up the index is trusted as long as the directory's mtime hasn't changed since it was written and every
+ *  game in it still has the size and mtime it was indexed with, a stat per game but no directory read. Changing a game
+ *  in place (chmod, overwrite under the same name) doesn't touch the directory mtime, that is what the second check
+ *  is for. Otherwise the directory is read once, only game_ entries are stat'ed, and the index is rewritten.
+ *  While the console runs, inotify events update single entries so new or removed games show up without a rescan.
+ *  A catalog can also come from a bundle (lib/bundle.h), then the entries are the bundle's table and never change.
+ *  A game's title, description and author (lib/game_info.h) aren't part of the index, the menu reads them from the
+ *  game's file for the entries it shows.
+ */
+
+#include "bundle.h"
+#include "game_info.h"
+
+#define catalog_index_name ".vgc_catalog"
+#define max_game_name 64
+
+typedef struct {
+    char name[max_game_name];
+    long long size;
+    long long mtime_ns;
+    int executable;
+} CatalogEntry;
+
+typedef struct {
+    int dir_fd; // -1 for a bundle
+    int inotify_fd; // -1 until catalog_watch
+    Bundle* bundle; // NULL for a directory
+
+    CatalogEntry* entries; // sorted by name, only executable regular game_ files
+    int num_entries;
+    int capacity;
+
+    int from_index; // 1 if the last load came from the index without reading the directory
+} Catalog;
+
+int is_game_name(const char* filename);
+
+Catalog* load_catalog(const char* dir);
+// the game_ entries of a bundle, NULL with errno set if the bundle can't be opened
+Catalog* load_catalog_bundle(const char* path);
+void free_catalog(Catalog* catalog);
+
+// starts watching the directory, returns the inotify fd to wait on or -1 (always for a bundle)
+int catalog_watch(Catalog* catalog);
+
+// reads the pending inotify events and updates the entries, returns 1 if the list changed
+int catalog_handle_events(Catalog* catalog);
+
+// index of the game with this name, -1 if it isn't there
+int catalog_find(const Catalog* catalog, const char* name);
+
+// the info note of entry idx, from the game's file or its bytes in the bundle. Returns 0, or -1 if it has none
+int catalog_game_info(const Catalog* catalog, int idx, GameInfo* info);
+
+#endif
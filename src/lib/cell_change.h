@@ -0,0 +1,11 @@
+#ifndef VGC_CELL_CHANGE_H
+#define VGC_CELL_CHANGE_H
+
+// a cell a game step changed, in game coordinates. The front ends draw these, the cores never touch the terminal
+typedef struct {
+    int x;
+    int y;
+    char c;
+} CellChange;
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef VGC_CLOCK_H
+#define VGC_CLOCK_H
+
+#include <time.h>
+
+// CLOCK_MONOTONIC in nanoseconds, the one time base for scheduling and measurements
+static inline long long monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+EventLoop* create_event_loop(void) {
+    EventLoop* loop = malloc(sizeof(EventLoop));
+    if (loop == NULL)
+        return NULL;
+
+    loop->input_fd = STDIN_FILENO;
+    loop->num_extra_fds = 0;
+
+    sigemptyset(&loop->handled_signals);
+    sigaddset(&loop->handled_signals, SIGINT);
+    sigaddset(&loop->handled_signals, SIGTERM);
+    sigaddset(&loop->handled_signals, SIGWINCH);
+
+    // the signals have to be blocked, otherwise they are delivered the usual way and never show up on the signalfd
+    sigprocmask(SIG_BLOCK, &loop->handled_signals, &loop->original_mask);
+
+    loop->signal_fd = signalfd(-1, &loop->handled_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (loop->signal_fd == -1 || loop->timer_fd == -1) {
+        free_event_loop(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void free_event_loop(EventLoop* loop) {
+    if (loop != NULL) {
+        if (loop->signal_fd != -1) {
+            // whatever is still pending would be delivered the usual way once the mask is back, to ncurses' handlers
+            struct signalfd_siginfo info;
+            while (read(loop->signal_fd, &info, sizeof(info)) == sizeof(info)) {}
+            close(loop->signal_fd);
+        }
+        if (loop->timer_fd != -1)
+            close(loop->timer_fd);
+        sigprocmask(SIG_SETMASK, &loop->original_mask, NULL);
+        free(loop);
+    }
+}
+
+void event_loop_set_timer(EventLoop* loop, const long long period_ns) {
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_ns / 1000000000ll;
+    spec.it_interval.tv_nsec = period_ns % 1000000000ll;
+    spec.it_value = spec.it_interval; // first expiration one period from now, all zero disarms the timer
+    timerfd_settime(loop->timer_fd, 0, &spec, NULL);
+}
+
+void event_loop_catch_suspend(EventLoop* loop) {
+    sigset_t tstp;
+    sigemptyset(&tstp);
+    sigaddset(&tstp, SIGTSTP);
+    sigprocmask(SIG_BLOCK, &tstp, NULL); // original_mask stays the one from before the loop, children get that
+    sigaddset(&loop->handled_signals, SIGTSTP);
+    signalfd(loop->signal_fd, &loop->handled_signals, 0);
+}
+
+int event_loop_add_fd(EventLoop* loop, const int fd) {
+    if (fd == -1 || loop->num_extra_fds == max_extra_fds)
+        return 0;
+    loop->extra_fds[loop->num_extra_fds] = fd;
+    return EVENT_FD(loop->num_extra_fds++);
+}
+
+static int read_signals(EventLoop* loop) {
+    int flags = 0;
+    struct signalfd_siginfo info;
+    while (read(loop->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGWINCH)
+            flags |= EVENT_RESIZE;
+        else if (info.ssi_signo == SIGTSTP)
+            flags |= EVENT_SUSPEND;
+        else
+            flags |= EVENT_QUIT;
+    }
+    return flags;
+}
+
+LoopEvents event_loop_wait(EventLoop* loop) {
+    LoopEvents events = {0, 0};
+
+    struct pollfd fds[3 + max_extra_fds] = {
+        {.fd = loop->input_fd, .events = POLLIN}, // poll skips it when it is -1
+        {.fd = loop->timer_fd, .events = POLLIN},
+        {.fd = loop->signal_fd, .events = POLLIN},
+    };
+    for (int i = 0; i < loop->num_extra_fds; i++)
+        fds[3 + i] = (struct pollfd) {.fd = loop->extra_fds[i], .events = POLLIN};
+
+    while (events.flags == 0) {
+        if (poll(fds, 3 + loop->num_extra_fds, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            events.flags = EVENT_QUIT; // nothing sensible left to wait on
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+            events.flags |= EVENT_INPUT;
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL))
+            events.flags |= EVENT_QUIT; // the terminal is gone, getch() would return ERR forever
+
+        uint64_t expirations;
+        if ((fds[1].revents & POLLIN) && read(loop->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            events.flags |= EVENT_TICK;
+            events.ticks = expirations;
+        }
+
+        if (fds[2].revents & POLLIN)
+            events.flags |= read_signals(loop);
+
+        for (int i = 0; i < loop->num_extra_fds; i++) {
+            if (fds[3 + i].revents & (POLLIN | POLLHUP | POLLERR))
+                events.flags |= EVENT_FD(i);
+        }
+    }
+    return events;
+}
@@ -0,0 +1,53 @@
+#ifndef VGC_EVENT_LOOP_H
+#define VGC_EVENT_LOOP_H
+
+#include <signal.h>
+
+/*  Blocking main loop shared by the console and the games.
+ *  event_loop_wait() sleeps in poll() until stdin is readable, the tick timer fires or a signal arrives,
+ *  so an idle process never wakes up. SIGINT, SIGTERM and SIGWINCH are blocked and read from a signalfd,
+ *  which lets the caller clean up from the main loop instead of from a signal handler.
+ *  SIGTSTP (ctrl+z) is only caught for those that ask for it, everyone else gets stopped the usual way.
+ */
+
+#define EVENT_INPUT  1 // stdin has bytes, drain getch() until ERR
+#define EVENT_TICK   2 // the timer expired, see LoopEvents.ticks
+#define EVENT_QUIT   4 // SIGINT or SIGTERM
+#define EVENT_RESIZE 8 // SIGWINCH
+#define EVENT_SUSPEND 16 // SIGTSTP, after event_loop_catch_suspend()
+#define EVENT_FD(i)  (32 << (i)) // the i-th fd added with event_loop_add_fd is readable
+
+#define max_extra_fds 4
+
+typedef struct {
+    int input_fd; // STDIN_FILENO, set it to -1 in a process that doesn't read the terminal (the multiplayer server)
+    int timer_fd;
+    int signal_fd;
+
+    int extra_fds[max_extra_fds];
+    int num_extra_fds;
+
+    sigset_t handled_signals;
+    sigset_t original_mask; // the mask before we blocked the signals, child processes get this one
+} EventLoop;
+
+typedef struct {
+    int flags;
+    unsigned long ticks; // timer expirations since the last wait, more than 1 means we were late
+} LoopEvents;
+
+EventLoop* create_event_loop(void);
+void free_event_loop(EventLoop* loop);
+
+// starts the periodic timer with the given period, 0 stops it. Setting it again restarts the period from now
+void event_loop_set_timer(EventLoop* loop, long long period_ns);
+
+// reports ctrl+z as EVENT_SUSPEND instead of letting it stop the process, see renderer_suspend()
+void event_loop_catch_suspend(EventLoop* loop);
+
+// wait for another fd as well (inotify, sockets...), returns the EVENT_FD flag it reports with or 0 if full
+int event_loop_add_fd(EventLoop* loop, int fd);
+
+LoopEvents event_loop_wait(EventLoop* loop);
+
+#endif
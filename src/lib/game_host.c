@@ -0,0 +1,348 @@
+#include "game_host.h"
+#include "clock.h"
+#include "perf.h"
+#include "scores.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ncurses.h>
+
+// the keys the recording has for the coming tick go in right before it, the same place they went in while recording
+static void feed_replay_keys(const VgcGame* game, void* state, GameSession* session) {
+    int key;
+    while ((key = replay_next_key(session->replay, session->ticks)) != -1)
+        game->input(state, key);
+}
+
+// the batch of keys that came in since the last tick, in the order they were typed
+static void feed_queued_keys(const VgcGame* game, void* state, GameSession* session) {
+    int keys[input_ring_capacity];
+    const int n = input_take_batch(&session->input, keys, input_ring_capacity);
+    for (int i = 0; i < n; i++)
+        game->input(state, keys[i]);
+}
+
+// the keys queued since the last call go into the recording with the tick they will be applied on
+static void record_new_keys(GameSession* session) {
+    InputQueue* q = &session->input;
+    for (; session->recorded_keys != q->head; session->recorded_keys++)
+        record_key(session->recorder, session->ticks, q->events[session->recorded_keys % input_ring_capacity].key);
+}
+
+static void finish_session(const VgcGame* game, void* state, GameSession* session) {
+    // keys after the last tick still count for the hash, the recording has them too
+    if (session->replay != NULL)
+        feed_replay_keys(game, state, session);
+    else
+        feed_queued_keys(game, state, session);
+    session->final_hash = game->hash(state);
+    session->state = NULL;
+    // a replay scores what the recording already scored
+    if (game->score != NULL && session->replay == NULL && session->ticks > 0)
+        scores_submit(game->name, game->score(state), session->ticks * 1000 / game->tick_hz, session->seed);
+    game->shutdown(state);
+}
+
+void end_suspended_game(const VgcGame* game, GameSession* session) {
+    if (session->state != NULL)
+        finish_session(game, session->state, session);
+}
+
+int run_game(const VgcGame* game, EventLoop* loop, Renderer* renderer, Scheduler* scheduler, GameSession* session) {
+    // a suspended game goes on with the state, ticks and recording it had
+    void* state = session->state;
+    if (state == NULL) {
+        state = game->init(session->seed);
+        if (state == NULL)
+            return GAME_FAILED;
+        session->ticks = 0;
+        input_init(&session->input);
+        session->recorded_keys = 0;
+        session->game_over = 0;
+    }
+
+    // vgc-top shows the game while it runs, the console gets its own name back after
+    char host_name[sizeof(((PerfBlock*) 0)->name)] = "";
+    if (perf_block != NULL) {
+        memcpy(host_name, perf_block->name, sizeof(host_name));
+        perf_set_name(game->name);
+        perf_set(&perf_block->tick_hz, 1000000000ll / scheduler->tick_ns);
+    }
+
+    // the console's own fds (inotify...) wait until it is back in the menu, poll would keep reporting them otherwise
+    const int num_extra_fds = loop->num_extra_fds;
+    loop->num_extra_fds = 0;
+
+    renderer_clear(renderer);
+    game->render(state, renderer, 1);
+    renderer_flush(renderer);
+
+    scheduler_reset(scheduler);
+    if (!session->game_over)
+        event_loop_set_timer(loop, scheduler_timer_period_ns(scheduler));
+
+    int result = GAME_LEFT;
+    int run = 1;
+
+    while (run) {
+        LoopEvents events = event_loop_wait(loop); // sleeps until a key, a tick or a signal
+
+        if (events.flags & EVENT_QUIT) {
+            result = GAME_QUIT;
+            run = 0;
+        }
+        if (events.flags & EVENT_RESIZE) {
+            renderer_resize_to_terminal(renderer);
+            renderer_flush(renderer);
+        }
+        if (events.flags & EVENT_SUSPEND) {
+            if (session->keep_on_suspend && result != GAME_QUIT) {
+                result = GAME_SUSPENDED;
+                run = 0;
+            }
+            else if (renderer_suspend(renderer))
+                scheduler_reset(scheduler); // the time we were stopped isn't caught up
+            else {
+                // ended while suspended, the terminal belongs to someone else: no more keys and no more frames
+                result = GAME_QUIT;
+                run = 0;
+                events.flags = 0;
+            }
+        }
+
+        // stops at q, whatever was typed after it belongs to the menu
+        if ((events.flags & EVENT_INPUT) && input_drain(&session->input, 'q'))
+            run = 0;
+        if (session->replay != NULL)
+            input_clear(&session->input); // the keys come from the recording, only q counts
+        else if (session->recorder != NULL)
+            record_new_keys(session);
+
+        if ((events.flags & EVENT_TICK) && !session->game_over) {
+            const int due = scheduler_ticks_due(scheduler);
+            for (int i = 0; i < due && !session->game_over; i++) {
+                if (session->replay != NULL) {
+                    if (session->ticks == session->replay->end_tick) {
+                        session->game_over = 1; // the recording ends here, leave the last frame up until q
+                        break;
+                    }
+                    feed_replay_keys(game, state, session);
+                }
+                else
+                    feed_queued_keys(game, state, session);
+                scheduler_begin_update(scheduler);
+                session->game_over = game->step(state);
+                game->render(state, renderer, 0);
+                scheduler_end_update(scheduler);
+                session->ticks++;
+            }
+            if (session->game_over)
+                event_loop_set_timer(loop, 0); // nothing moves anymore, only wake up for input
+
+            if (session->game_over || scheduler_render_due(scheduler)) {
+                scheduler_begin_render(scheduler);
+                renderer_flush(renderer); // one refresh for everything the ticks changed
+                scheduler_end_render(scheduler);
+                perf_sample_heap_if_due();
+            }
+        }
+    }
+
+    event_loop_set_timer(loop, 0);
+    loop->num_extra_fds = num_extra_fds;
+    if (perf_block != NULL) {
+        perf_set(&perf_block->tick_hz, 0);
+        perf_set_name(host_name);
+    }
+    if (result == GAME_SUSPENDED)
+        session->state = state;
+    else
+        finish_session(game, state, session);
+    return result;
+}
+
+int run_headless(const VgcGame* game, Renderer* renderer, Scheduler* scheduler, GameSession* session) {
+    void* state = game->init(session->seed);
+    if (state == NULL)
+        return GAME_FAILED;
+    session->ticks = 0;
+
+    game->render(state, renderer, 1);
+    renderer_flush(renderer);
+
+    // no clock, so a frame goes out every this many ticks, the rate the terminal would have seen them at
+    const int ticks_per_frame = game->tick_hz > game->render_hz ? game->tick_hz / game->render_hz : 1;
+
+    // a recorded game stops ticking when it is over, so end_tick never runs past it
+    while (session->ticks < session->replay->end_tick) {
+        feed_replay_keys(game, state, session);
+        scheduler_begin_update(scheduler);
+        game->step(state);
+        game->render(state, renderer, 0);
+        scheduler_end_update(scheduler);
+        session->ticks++;
+
+        if (session->ticks % ticks_per_frame == 0) {
+            scheduler_begin_render(scheduler);
+            renderer_flush(renderer);
+            scheduler_end_render(scheduler);
+        }
+    }
+    scheduler->ticks = session->ticks; // nothing went through scheduler_ticks_due
+
+    finish_session(game, state, session);
+    return GAME_LEFT;
+}
+
+static const char* arg_value(const int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return argv[i + 1];
+    }
+    return NULL;
+}
+
+static int has_arg(const int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// the one line a regression run compares, printed for every replay whether or not VGC_STATS is set
+static void report_replay(const VgcGame* game, const GameSession* session, const Renderer* renderer,
+                          const Scheduler* scheduler, const double seconds) {
+    const int matches = session->ticks == session->replay->end_tick
+                        && session->final_hash == session->replay->final_hash;
+    printf("%s replay: %lu/%lu ticks in %.3f s (%.0f ticks/s), update mean %.2fus p99<=%.1fus, "
+           "%ld cells %ld bytes rendered, hash %016llx %s\n",
+           game->name, session->ticks, session->replay->end_tick, seconds, seconds > 0 ? session->ticks / seconds : 0.0,
+           scheduler->update.count > 0 ? (double) scheduler->update.total_ns / scheduler->update.count / 1000.0 : 0.0,
+           histogram_percentile_ns(&scheduler->update, 0.99) / 1000.0, renderer->stats.total_cells_changed,
+           renderer->stats.total_bytes_written, (unsigned long long) session->final_hash,
+           matches ? "matches the recording" : "DIFFERS from the recording");
+}
+
+int run_standalone(const VgcGame* game, const int argc, char** argv) {
+    GameSession session;
+    memset(&session, 0, sizeof(session));
+    session.seed = monotonic_ns() ^ getpid();
+    if (arg_value(argc, argv, "--seed") != NULL)
+        session.seed = strtoul(arg_value(argc, argv, "--seed"), NULL, 0);
+
+    const char* replay_path = arg_value(argc, argv, "--replay");
+    const int headless = has_arg(argc, argv, "--headless");
+    if (headless && replay_path == NULL) {
+        printf("--headless needs --replay <file>\n");
+        return 1;
+    }
+    if (replay_path != NULL) {
+        session.replay = load_replay(replay_path);
+        if (session.replay == NULL) {
+            printf("Could not load %s: %s\n", replay_path, errno == EINVAL ? "not a complete recording" : strerror(errno));
+            return 1;
+        }
+        if (strcmp(session.replay->game, game->name) != 0) {
+            printf("%s is a recording of %s, not of %s\n", replay_path, session.replay->game, game->name);
+            free_replay(session.replay);
+            return 1;
+        }
+        session.seed = session.replay->seed;
+
+        // the same keys on another board go a different way, better to say so than to replay into a wrong hash
+        int width = 0, height = 0;
+        if (game->board_size != NULL)
+            game->board_size(&width, &height);
+        if (session.replay->board_width != 0
+            && (session.replay->board_width != width || session.replay->board_height != height)) {
+            printf("%s was recorded on a %dx%d board, this one is %dx%d\n", replay_path, session.replay->board_width,
+                   session.replay->board_height, width, height);
+            free_replay(session.replay);
+            return 1;
+        }
+    }
+
+    const char* record_path = arg_value(argc, argv, "--record");
+    if (record_path != NULL && replay_path == NULL) {
+        int width = 0, height = 0;
+        if (game->board_size != NULL)
+            game->board_size(&width, &height);
+        session.recorder = start_recording(record_path, game->name, session.seed, width, height);
+        if (session.recorder == NULL) {
+            perror("could not create the recording");
+            return 1;
+        }
+    }
+
+    // without a terminal there is nothing to clean up after a ctrl+c, so headless keeps the default signals
+    EventLoop* loop = NULL;
+    if (!headless) {
+        // SIGINT and SIGTERM arrive through the event loop, so the cleanup below runs from here and not from a signal handler
+        loop = create_event_loop();
+        if (loop == NULL) {
+            printf("Failed to set up the event loop\n");
+            return 1;
+        }
+        event_loop_catch_suspend(loop); // ctrl+z goes through run_game, which repaints after fg
+    }
+    if (trace_start_from_args(argc, argv, game->name) == -1) { // after the event loop, so the writer thread has the signals blocked too
+        free_event_loop(loop);
+        return 1;
+    }
+
+    Renderer* renderer;
+    Scheduler* scheduler = create_scheduler(game->tick_hz, game->render_hz);
+    const long long start = monotonic_ns();
+    int result;
+    if (headless) {
+        renderer = create_headless_renderer(80, 25);
+        result = renderer != NULL && scheduler != NULL ? run_headless(game, renderer, scheduler, &session) : GAME_FAILED;
+    }
+    else {
+        if (session.replay == NULL)
+            scores_start();
+        perf_start(game->name);
+        init_terminal();
+        renderer = create_renderer(COLS, LINES);
+        result = renderer != NULL && scheduler != NULL ? run_game(game, loop, renderer, scheduler, &session)
+                                                       : GAME_FAILED;
+
+        // ended while suspended by the console, which has the terminal now
+        if (terminal_in_foreground()) {
+            clear();
+            endwin();
+            system("clear");
+        }
+        perf_stop();
+    }
+    const double seconds = (monotonic_ns() - start) / 1e9;
+
+    int status = result == GAME_FAILED;
+    if (result == GAME_FAILED)
+        printf("Failed to allocate memory for %s\n", game->name);
+    if (session.recorder != NULL && finish_recording(session.recorder, session.ticks, session.final_hash) == -1) {
+        perror("could not write the recording");
+        status = 1;
+    }
+    if (session.replay != NULL && result != GAME_FAILED) {
+        report_replay(game, &session, renderer, scheduler, seconds);
+        if (session.final_hash != session.replay->final_hash)
+            status = 1;
+    }
+    renderer_report_stats(renderer, game->name, stderr);
+    scheduler_report_stats(scheduler, game->name, stderr);
+    if (!headless)
+        input_report_stats(&session.input, game->name, stderr);
+    free_replay(session.replay);
+    free_renderer(renderer);
+    free_scheduler(scheduler);
+    free_event_loop(loop);
+    trace_stop();
+    scores_stop();
+    return status;
+}
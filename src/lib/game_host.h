@@ -0,0 +1,83 @@
+#ifndef VGC_GAME_HOST_H
+#define VGC_GAME_HOST_H
+
+#include <stdint.h>
+
+#include "event_loop.h"
+#include "input.h"
+#include "render.h"
+#include "replay.h"
+#include "scheduler.h"
+
+/*  The game plugin ABI and the loop that runs a game.
+ *  A game describes itself with a VgcGame and never touches the terminal or the event loop, run_game() owns both.
+ *  Standalone, a game's main() is only run_standalone(). Built with -DVGC_PLUGIN -shared, the same source exports its
+ *  VgcGame as vgc_game, and the console dlopen()s it and runs it in its own screen and event loop, no process spawn,
+ *  no second initscr() and nothing to repaint when it returns.
+ *  Every key the game sees goes through run_game() and is applied on a tick, so a game is a pure function of its seed
+ *  and of which keys came before which tick. That is what --record writes and --replay feeds back (lib/replay.h).
+ *  Keys wait in an InputQueue (lib/input.h) and each tick hands the game all of them in order, right before step,
+ *  so input() sees the whole batch of a tick and decides what it means.
+ *  When a game played from the keyboard ends, its score goes into the journal of lib/scores.h.
+ *  ctrl+z suspends a game. A standalone game stops its process, so the shell or the console that started it can
+ *  continue it later. A plugin can't stop the console it runs in: run_game() returns with the state kept in the
+ *  session, and the next run_game() on that session picks it up where it was.
+ */
+
+#define VGC_GAME_ABI 4
+#define VGC_GAME_SYMBOL "vgc_game"
+
+typedef struct {
+    int abi_version; // VGC_GAME_ABI the game was built with, the console refuses anything else
+    const char* name;
+    int tick_hz;
+    int render_hz;
+
+    void* (*init)(unsigned long seed);   // returns the game state, NULL if it couldn't be allocated
+    void (*input)(void* state, int key); // any key but q, already lowercase, arrows as KEY_UP...
+    int (*step)(void* state);            // one tick, returns 1 once the game is over and nothing moves anymore
+    // draws into the back buffer: everything when full is set, otherwise what the last step changed
+    void (*render)(void* state, Renderer* r, int full);
+    void (*shutdown)(void* state);
+    uint64_t (*hash)(void* state); // of everything the next ticks depend on, compared at the end of a replay
+    int64_t (*score)(void* state); // what goes into the high scores (lib/scores.h) when a game ends, NULL for none
+    // the board size the next init plays on, which a recording keeps and a replay has to match. NULL for a fixed board
+    void (*board_size)(int* width, int* height);
+} VgcGame;
+
+typedef struct {
+    unsigned long seed;
+    ReplayRecorder* recorder; // if set, every key that reaches the game is logged to it
+    Replay* replay;           // if set, the keys come from it instead of the keyboard, q still leaves
+    int keep_on_suspend;      // ctrl+z returns GAME_SUSPENDED and keeps state, instead of stopping the process
+
+    // filled in by run_game
+    InputQueue input; // the keys waiting for the next tick, with their depth and age stats
+    unsigned int recorded_keys; // input.head as of the last record_key
+    unsigned long ticks;
+    int game_over; // step returned 1, the last frame stays up until q
+    uint64_t final_hash;
+    void* state; // the game's state while it is suspended, NULL otherwise
+} GameSession;
+
+#define GAME_FAILED -1 // init returned NULL
+#define GAME_LEFT    0 // the player pressed q
+#define GAME_QUIT    1 // SIGINT or SIGTERM, whoever runs the game should exit as well
+#define GAME_SUSPENDED 2 // ctrl+z with keep_on_suspend, session->state holds the game until it is run again
+
+// runs the game on the given screen and loop until q, a quit signal or the end of the replay,
+// returns one of the GAME_ results above
+int run_game(const VgcGame* game, EventLoop* loop, Renderer* renderer, Scheduler* scheduler, GameSession* session);
+
+// ends a suspended game without running it again: its score is kept like after q and its state freed
+void end_suspended_game(const VgcGame* game, GameSession* session);
+
+// plays a session->replay back without a terminal or a timer, as fast as the ticks run
+int run_headless(const VgcGame* game, Renderer* renderer, Scheduler* scheduler, GameSession* session);
+
+/*  the whole main() of a standalone game: sets up the loop and the terminal, runs the game and reports stats.
+ *  Options: --seed <n>, --record <file>, --replay <file> [--headless], --trace <file>
+ */
+int run_standalone(const VgcGame* game, int argc, char** argv);
+
+#endif
@@ -0,0 +1,89 @@
+#include "game_info.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t align4(const size_t n) {
+    return (n + 3) & ~(size_t) 3;
+}
+
+// the next string of the note's desc into out, cut to fit. Returns where the one after it starts
+static size_t take_string(const char* desc, const size_t at, const size_t size, char* out, const size_t out_size) {
+    size_t end = at;
+    while (end < size && desc[end] != '\0')
+        end++;
+    snprintf(out, out_size, "%.*s", (int) (end - at), desc + at);
+    return end < size ? end + 1 : end;
+}
+
+// looks through the notes of one PT_NOTE segment, the game's is usually next to the build id
+static int parse_notes(const unsigned char* notes, const size_t size, GameInfo* info) {
+    size_t at = 0;
+    while (at + sizeof(Elf64_Nhdr) <= size) {
+        Elf64_Nhdr header;
+        memcpy(&header, notes + at, sizeof(header));
+        const size_t name_at = at + sizeof(header);
+        const size_t desc_at = name_at + align4(header.n_namesz);
+        if (header.n_namesz > size || header.n_descsz > size || desc_at + header.n_descsz > size)
+            return -1;
+
+        if (header.n_type == VGC_NOTE_INFO && header.n_namesz == sizeof(VGC_NOTE_OWNER)
+            && memcmp(notes + name_at, VGC_NOTE_OWNER, sizeof(VGC_NOTE_OWNER)) == 0) {
+            const char* desc = (const char*) notes + desc_at;
+            size_t next = take_string(desc, 0, header.n_descsz, info->title, sizeof(info->title));
+            next = take_string(desc, next, header.n_descsz, info->description, sizeof(info->description));
+            take_string(desc, next, header.n_descsz, info->author, sizeof(info->author));
+            return 0;
+        }
+        at = desc_at + align4(header.n_descsz);
+    }
+    return -1;
+}
+
+int game_info_parse(const unsigned char* data, const size_t size, GameInfo* info) {
+    memset(info, 0, sizeof(GameInfo));
+    if (size < sizeof(Elf64_Ehdr) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64)
+        return -1;
+
+    Elf64_Ehdr elf;
+    memcpy(&elf, data, sizeof(elf));
+    if (elf.e_phentsize != sizeof(Elf64_Phdr) || elf.e_phoff > size
+        || elf.e_phnum > (size - elf.e_phoff) / sizeof(Elf64_Phdr))
+        return -1;
+
+    for (int i = 0; i < elf.e_phnum; i++) {
+        Elf64_Phdr segment;
+        memcpy(&segment, data + elf.e_phoff + i * sizeof(Elf64_Phdr), sizeof(segment));
+        if (segment.p_type != PT_NOTE || segment.p_offset > size || segment.p_filesz > size - segment.p_offset)
+            continue;
+        if (parse_notes(data + segment.p_offset, segment.p_filesz, info) == 0)
+            return 0;
+    }
+    return -1;
+}
+
+int game_info_read(const int dir_fd, const char* name, GameInfo* info) {
+    memset(info, 0, sizeof(GameInfo));
+    const int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    // only the pages the headers and the notes are on get read from the disk
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+    const int result = game_info_parse(data, st.st_size, info);
+    munmap(data, st.st_size);
+    return result;
+}
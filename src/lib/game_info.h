@@ -0,0 +1,50 @@
+#ifndef VGC_GAME_INFO_H
+#define VGC_GAME_INFO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  What the menu shows about a game, read from the game's file without running it.
+ *  A game's source says VGC_GAME_INFO(title, description, author) once, and the compiler puts that into an ELF note
+ *  of its own, in the executable and in the .so alike:
+ *
+ *      namesz 4 | descsz | type VGC_NOTE_INFO | "VGC\0" | title\0 description\0 author\0 | padding to 4 bytes
+ *
+ *  The note is allocated, so the linker puts it in a PT_NOTE segment next to the build id, a page or two into the
+ *  file. game_info_parse() only reads the ELF header, the program headers and the notes, so reading a game's info
+ *  from a mapping pages in the start of the file and nothing else.
+ */
+
+#define VGC_NOTE_OWNER "VGC"
+#define VGC_NOTE_INFO 1
+
+#define game_title_size 32
+#define game_description_size 96
+#define game_author_size 32
+
+typedef struct {
+    char title[game_title_size];
+    char description[game_description_size];
+    char author[game_author_size];
+} GameInfo;
+
+#define VGC_GAME_INFO_TEXT(title, description, author) title "\0" description "\0" author
+
+// at file scope in the game's source, with string literals
+#define VGC_GAME_INFO(title, description, author)                                                                     \
+    __attribute__((section(".note.vgc"), used, aligned(4))) static const struct {                                     \
+        uint32_t namesz;                                                                                               \
+        uint32_t descsz;                                                                                               \
+        uint32_t type;                                                                                                 \
+        char name[4];                                                                                                  \
+        char desc[(sizeof(VGC_GAME_INFO_TEXT(title, description, author)) + 3) / 4 * 4];                              \
+    } vgc_game_info = {4, sizeof(VGC_GAME_INFO_TEXT(title, description, author)), VGC_NOTE_INFO, VGC_NOTE_OWNER,     \
+                       VGC_GAME_INFO_TEXT(title, description, author)}
+
+// fills info from an ELF file's bytes, returns 0 or -1 if it isn't a 64-bit ELF file or has no VGC note
+int game_info_parse(const unsigned char* data, size_t size, GameInfo* info);
+
+// maps the file name in dir_fd just long enough to parse its note, returns 0 or -1
+int game_info_read(int dir_fd, const char* name, GameInfo* info);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef VGC_HASH_H
+#define VGC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  FNV-1a, 64 bit. Used for checksums and game state hashes, it catches corrupted data and diverging replays,
+ *  it isn't meant to stop anyone on purpose. Chain calls to hash several fields: h = hash_bytes(h, ...)
+ */
+
+#define hash_init 0xcbf29ce484222325ull
+
+static inline uint64_t hash_bytes(uint64_t hash, const void* data, const size_t size) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static inline uint64_t hash_int(const uint64_t hash, const long long value) {
+    return hash_bytes(hash, &value, sizeof(value));
+}
+
+#endif
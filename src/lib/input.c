@@ -0,0 +1,104 @@
+#include "input.h"
+#include "clock.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+
+#define key_escape 27
+
+void input_init(InputQueue* q) {
+    memset(q, 0, sizeof(InputQueue));
+}
+
+/*  ncurses gave back a bare ESC, so what follows didn't match terminfo (ESC [ A while the terminal is in application
+ *  mode, or the other way around). CSI and SS3 sequences are read up to their final byte. A lone ESC stays ESC and
+ *  ESC followed by a key, alt+key, becomes the key. Returns -1 for a sequence we have no use for
+ */
+static int decode_escape(void) {
+    const int next = getch();
+    if (next == ERR)
+        return key_escape;
+    if (next != '[' && next != 'O')
+        return next;
+
+    int final = getch();
+    // parameters and intermediates, e.g. the 1;5 of ctrl+up
+    while (final != ERR && final >= 0x20 && final < 0x40)
+        final = getch();
+    switch (final) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        default: return -1;
+    }
+}
+
+int input_drain(InputQueue* q, const int stop_key) {
+    // everything waiting arrived before this wakeup, the time we read it is as close as we get to when it was typed
+    const long long now = monotonic_ns();
+    const unsigned int before = q->head;
+    int ch;
+    while ((ch = getch()) != ERR) {
+        if (ch == key_escape && (ch = decode_escape()) == -1)
+            continue;
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 32; // make lowercase
+        trace_event(TRACE_INPUT, ch);
+        if (ch == stop_key) {
+            perf_input(q->head - before, q->head - q->tail);
+            return 1;
+        }
+
+        if (q->head - q->tail == input_ring_capacity) {
+            q->dropped++;
+            continue;
+        }
+        q->events[q->head % input_ring_capacity] = (InputEvent) {ch, now};
+        q->head++;
+        q->keys++;
+    }
+    perf_input(q->head - before, q->head - q->tail);
+    return 0;
+}
+
+int input_take_batch(InputQueue* q, int* keys, const int max) {
+    const long long now = monotonic_ns();
+    int n = 0;
+    while (q->tail != q->head && n < max) {
+        const InputEvent* e = &q->events[q->tail % input_ring_capacity];
+        keys[n++] = e->key;
+        histogram_add(&q->age, now - e->read_ns);
+        q->tail++;
+    }
+    perf_input(0, q->head - q->tail);
+
+    q->batches++;
+    q->depths[n < input_depth_buckets ? n : input_depth_buckets - 1]++;
+    if (n > q->max_depth)
+        q->max_depth = n;
+    return n;
+}
+
+void input_clear(InputQueue* q) {
+    q->tail = q->head;
+}
+
+void input_report_stats(const InputQueue* q, const char* name, FILE* out) {
+    if (getenv("VGC_STATS") == NULL)
+        return;
+
+    fprintf(out, "%s: %ld keys, %ld dropped, %ld batches, depth max %d:", name, q->keys, q->dropped, q->batches,
+            q->max_depth);
+    for (int i = 0; i < input_depth_buckets; i++) {
+        if (q->depths[i] > 0)
+            fprintf(out, " %d%s:%ld", i, i == input_depth_buckets - 1 ? "+" : "", q->depths[i]);
+    }
+    fprintf(out, "\n");
+    histogram_report(&q->age, "key age", out);
+}
@@ -0,0 +1,54 @@
+#ifndef VGC_INPUT_H
+#define VGC_INPUT_H
+
+#include <stdio.h>
+
+#include "scheduler.h"
+
+/*  Keyboard input between ticks. input_drain() reads every key that is waiting, on each wakeup, into a ring with
+ *  the time it was read, and a tick takes all of them at once with input_take_batch(). What a batch means is up to
+ *  the game: racing keeps the last steering key, snake queues the turns.
+ *  ncurses decodes the escape sequences it knows from terminfo (keypad is on). A sequence it doesn't know arrives as
+ *  ESC and its bytes: the arrow and home/end keys in either cursor mode are decoded here, anything else is dropped
+ *  instead of reaching the game as a stray '[' and letter.
+ *  Every batch records how many keys it held, and every key how long it waited for its tick.
+ */
+
+#define input_ring_capacity 64 // far more than anyone types in one tick, keys past it are dropped and counted
+#define input_depth_buckets 8  // batch depths 0 to 6, then 7 or more
+
+typedef struct {
+    int key;
+    long long read_ns;
+} InputEvent;
+
+typedef struct {
+    InputEvent events[input_ring_capacity];
+    unsigned int head; // next slot to write
+    unsigned int tail; // next slot to read
+
+    long keys;
+    long dropped;
+    long batches;
+    int max_depth;
+    long depths[input_depth_buckets]; // batches by how many keys they held
+    Histogram age; // from being read to being taken by a tick
+} InputQueue;
+
+void input_init(InputQueue* q);
+
+/*  reads keys until there are none left, lowercased, into the ring. Stops right after stop_key without queueing it,
+ *  whatever comes after it is left for whoever reads next (the console after a game). Returns 1 if it saw stop_key
+ */
+int input_drain(InputQueue* q, int stop_key);
+
+// moves every queued key into keys, oldest first, and records the batch. Returns how many
+int input_take_batch(InputQueue* q, int* keys, int max);
+
+// forgets the queued keys without counting them as a batch
+void input_clear(InputQueue* q);
+
+// prints the key counts, the batch depths and the key age histogram if VGC_STATS is set, call after endwin()
+void input_report_stats(const InputQueue* q, const char* name, FILE* out);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef VGC_MULTIPLAYER_H
+#define VGC_MULTIPLAYER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*  Wire format between vgc-server and vgc-client, SOCK_SEQPACKET over a Unix socket so every send is one message.
+ *  The server owns the road and the tick. Every tick it sends each client the cells that changed since the previous
+ *  tick, the same (x, y, c) CellChanges the games draw with, and every mp_keyframe_interval ticks the whole grid.
+ *  A client whose socket is full misses that frame and gets a keyframe instead of the next delta, so the server never
+ *  waits for anyone. Clients send their keys with the CLOCK_MONOTONIC time they were read at, which on one machine
+ *  is the same clock the server reads, so the server can tell how old an input is when it gets applied.
+ *  A client's first message is MSG_HELLO with its mp_version. The server only gives it a car if the version is its
+ *  own, otherwise it answers MSG_VERSION with the version it speaks and hangs up.
+ */
+
+#define mp_version 1
+#define mp_max_players 8
+#define mp_keyframe_interval 25 // ticks, 5 s at the racing tick rate
+
+#define MSG_HELLO    1 // client -> server, the first message
+#define MSG_INPUT    2 // client -> server
+#define MSG_WELCOME  3 // server -> client, the answer to MSG_HELLO
+#define MSG_FULL     4 // server -> client, all mp_max_players seats are taken
+#define MSG_KEYFRAME 5 // server -> client, every cell of the grid
+#define MSG_DELTA    6 // server -> client, the cells changed by the last tick
+#define MSG_VERSION  7 // server -> client, a HelloMsg with the server's mp_version, the answer to any other one
+
+typedef struct {
+    uint8_t type;
+    uint8_t version; // mp_version
+} HelloMsg;
+
+typedef struct {
+    uint8_t type;
+    int8_t direction; // left, neutral or right
+    uint8_t respawn;  // 1 to get back on the road after a crash
+    uint8_t reserved;
+    uint32_t seq;
+    int64_t sent_ns; // monotonic_ns() when the key was read
+} InputMsg;
+
+typedef struct {
+    uint8_t type;
+    uint8_t player; // 0 based, the car shows up as '1' + player
+    uint8_t width;
+    uint8_t height;
+    uint16_t tick_hz;
+} WelcomeMsg;
+
+// followed by count WireCells
+typedef struct {
+    uint8_t type;
+    uint8_t players;
+    uint16_t count;
+    uint32_t tick;
+} FrameHeader;
+
+// a CellChange as it goes over the wire
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    char c;
+} WireCell;
+
+#define mp_max_frame(width, height) (sizeof(FrameHeader) + sizeof(WireCell) * (width) * (height))
+
+// default socket, one per user so two people on the same machine don't end up in each other's game
+static inline void mp_default_socket(char* path, const size_t size) {
+    snprintf(path, size, "/tmp/vgc-racing-%u.sock", (unsigned) getuid());
+}
+
+#endif
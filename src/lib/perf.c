@@ -0,0 +1,138 @@
+#include "perf.h"
+#include "clock.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+PerfBlock* perf_block;
+static char shm_name[64];
+
+void perf_start(const char* name) {
+    const char* setting = getenv("VGC_PERF");
+    if (perf_block != NULL || (setting != NULL && strcmp(setting, "0") == 0))
+        return;
+
+    snprintf(shm_name, sizeof(shm_name), "/" PERF_PREFIX "%d", (int) getpid());
+    const int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return;
+    // ftruncate zeroes it, every counter starts at 0
+    PerfBlock* p = MAP_FAILED;
+    if (ftruncate(fd, sizeof(PerfBlock)) == 0)
+        p = mmap(NULL, sizeof(PerfBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(shm_name);
+        return;
+    }
+
+    memcpy(p->magic, PERF_MAGIC, sizeof(p->magic));
+    p->version = PERF_VERSION;
+    p->pid = getpid();
+    p->created_ns = monotonic_ns();
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    perf_block = p;
+    perf_sample_heap(p->created_ns);
+}
+
+void perf_set_name(const char* name) {
+    PerfBlock* p = perf_block;
+    if (p == NULL)
+        return;
+    // a reader that sees the same even seq before and after copying the name got a whole one
+    const uint32_t seq = atomic_load_explicit(&p->name_seq, memory_order_relaxed);
+    atomic_store_explicit(&p->name_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    atomic_store_explicit(&p->name_seq, seq + 2, memory_order_release);
+}
+
+void perf_sample_heap(const long long now_ns) {
+    const struct mallinfo2 info = mallinfo2();
+    perf_set(&perf_block->heap_bytes, info.uordblks + info.hblkhd); // small allocations and mmapped big ones
+    perf_block->heap_sampled_ns = now_ns;
+}
+
+void perf_stop(void) {
+    if (perf_block == NULL)
+        return;
+    atomic_store(&perf_block->closed, 1);
+    munmap(perf_block, sizeof(PerfBlock));
+    shm_unlink(shm_name);
+    perf_block = NULL;
+}
+
+const PerfBlock* perf_attach(const pid_t pid) {
+    char name[64];
+    snprintf(name, sizeof(name), "/" PERF_PREFIX "%d", (int) pid);
+    const int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1)
+        return NULL;
+
+    PerfBlock* p = MAP_FAILED;
+    struct stat st;
+    // a block that was just created may not have its size yet
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(PerfBlock))
+        p = mmap(NULL, sizeof(PerfBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (memcmp(p->magic, PERF_MAGIC, sizeof(p->magic)) != 0 || p->version != PERF_VERSION) {
+        munmap(p, sizeof(PerfBlock));
+        errno = EINVAL;
+        return NULL;
+    }
+    return p;
+}
+
+void perf_detach(const PerfBlock* p) {
+    if (p != NULL)
+        munmap((void*) p, sizeof(PerfBlock));
+}
+
+void perf_read_name(const PerfBlock* p, char* name, const size_t size) {
+    for (int attempt = 0; attempt < 100; attempt++) {
+        const uint32_t before = atomic_load_explicit(&p->name_seq, memory_order_acquire);
+        snprintf(name, size, "%.*s", (int) sizeof(p->name), p->name);
+        atomic_thread_fence(memory_order_acquire);
+        if (before % 2 == 0 && atomic_load_explicit(&p->name_seq, memory_order_relaxed) == before)
+            return;
+    }
+    snprintf(name, size, "?");
+}
+
+static int compare_pids(const void* a, const void* b) {
+    return *(const pid_t*) a - *(const pid_t*) b;
+}
+
+int perf_find_all(pid_t* pids, const int max) {
+    DIR* dir = opendir("/dev/shm");
+    if (dir == NULL)
+        return 0;
+
+    int n = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && n < max) {
+        if (strncmp(entry->d_name, PERF_PREFIX, strlen(PERF_PREFIX)) != 0)
+            continue;
+        const pid_t pid = atoi(entry->d_name + strlen(PERF_PREFIX));
+        // a process that crashed leaves its block behind
+        if (pid <= 0 || (kill(pid, 0) == -1 && errno == ESRCH))
+            continue;
+        pids[n++] = pid;
+    }
+    closedir(dir);
+    qsort(pids, n, sizeof(pid_t), compare_pids);
+    return n;
+}
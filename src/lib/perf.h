@@ -0,0 +1,127 @@
+#ifndef VGC_PERF_H
+#define VGC_PERF_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "clock.h"
+#include "scheduler.h"
+
+/*  Live performance counters. Every interactive binary maps one fixed-layout PerfBlock in POSIX shared memory,
+ *  /dev/shm/vgc-perf-<pid>, and bumps its counters as it ticks, renders and reads keys. vgc-top maps the blocks of
+ *  all running sessions read-only and turns two samples a second apart into rates and percentiles.
+ *  There is a single writer per block, so a counter is bumped with a relaxed load and store, no locked instruction
+ *  and nothing a reader can hold up: a few nanoseconds a tick. Tick times go into log2 buckets like the scheduler's
+ *  histograms, a reader diffs two snapshots of them to get the p50 and p99 of the last second.
+ *  A reader can see one counter updated and the next one not yet, which only moves a number by one sample.
+ *  Set VGC_PERF=0 to publish nothing.
+ */
+
+#define PERF_MAGIC "VGCPERF1"
+#define PERF_VERSION 1
+#define PERF_PREFIX "vgc-perf-" // + pid, under /dev/shm
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    long long created_ns; // CLOCK_MONOTONIC
+    _Atomic uint32_t closed;
+    _Atomic uint32_t name_seq; // odd while name is being changed
+    char name[32];             // the game running in this process, the console's name while it is in the menu
+
+    _Atomic uint64_t tick_hz;
+    _Atomic uint64_t ticks;
+    _Atomic uint64_t missed_deadlines; // ticks that ran more than one period late, or were dropped
+    _Atomic uint64_t tick_ns_total;
+    _Atomic uint64_t tick_buckets[histogram_buckets]; // update time, bucket i is below 2^i microseconds
+
+    _Atomic uint64_t frames;
+    _Atomic uint64_t cells_changed;
+    _Atomic uint64_t bytes_written;
+
+    _Atomic uint64_t keys;
+    _Atomic uint64_t input_depth; // keys waiting for the next tick right now
+
+    _Atomic uint64_t heap_bytes; // in use by malloc, sampled about once a second, the size of the game state and all
+    long long heap_sampled_ns;   // only the writer reads this one
+} PerfBlock;
+
+extern PerfBlock* perf_block;
+
+// creates the block for this process unless VGC_PERF=0, quietly does nothing if shared memory isn't available
+void perf_start(const char* name);
+// the console runs plugins in its own process, it renames its block for the time the game runs
+void perf_set_name(const char* name);
+// marks the block closed and removes its name
+void perf_stop(void);
+
+// the reading side, for vgc-top. Maps the block of pid read-only, NULL with errno EINVAL if it isn't one
+const PerfBlock* perf_attach(pid_t pid);
+void perf_detach(const PerfBlock* p);
+// copies the name, retrying while the writer is in the middle of changing it
+void perf_read_name(const PerfBlock* p, char* name, size_t size);
+// the pids of the live processes with a block, up to max of them, lowest first. Returns how many
+int perf_find_all(pid_t* pids, int max);
+
+// single writer, so no read-modify-write instruction is needed
+static inline void perf_add(_Atomic uint64_t* counter, const uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void perf_set(_Atomic uint64_t* counter, const uint64_t value) {
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+void perf_sample_heap(long long now_ns);
+
+// after each tick, with how long its update took
+static inline void perf_tick(const long long update_ns) {
+    PerfBlock* p = perf_block;
+    if (p == NULL)
+        return;
+    const long long us = update_ns / 1000;
+    int bucket = us <= 0 ? 0 : 64 - __builtin_clzll((unsigned long long) us);
+    if (bucket >= histogram_buckets)
+        bucket = histogram_buckets - 1;
+    perf_add(&p->tick_buckets[bucket], 1);
+    perf_add(&p->tick_ns_total, update_ns);
+    perf_add(&p->ticks, 1);
+}
+
+/*  mallinfo2 walks and locks every malloc arena, so the heap is sampled after a frame is out and not on the tick,
+ *  where it would show up in the tick times. Once a second at most
+ */
+static inline void perf_sample_heap_if_due(void) {
+    if (perf_block == NULL)
+        return;
+    const long long now_ns = monotonic_ns();
+    if (now_ns - perf_block->heap_sampled_ns > 1000000000ll)
+        perf_sample_heap(now_ns);
+}
+
+// a tick that ran more than a period late, or was dropped
+static inline void perf_missed_deadline(void) {
+    if (perf_block != NULL)
+        perf_add(&perf_block->missed_deadlines, 1);
+}
+
+static inline void perf_frame(const int cells, const long bytes) {
+    PerfBlock* p = perf_block;
+    if (p == NULL)
+        return;
+    perf_add(&p->frames, 1);
+    perf_add(&p->cells_changed, cells);
+    perf_add(&p->bytes_written, bytes);
+}
+
+static inline void perf_input(const int keys, const int depth) {
+    PerfBlock* p = perf_block;
+    if (p == NULL)
+        return;
+    perf_add(&p->keys, keys);
+    perf_set(&p->input_depth, depth);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "racing_core.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+Road* create_initial_road(const int width, const int height, const unsigned long seed) {
+    return create_road_in(NULL, width, height, seed);
+}
+
+Road* create_road_in(Arena* arena, const int width, const int height, const unsigned long seed) {
+    Road* road = arena != NULL ? arena_alloc(arena, sizeof(Road)) : malloc(sizeof(Road));
+    if (road == NULL)
+        return NULL;
+
+    road->width = width;
+    road->height = height;
+    road->words_per_row = (width + 63) / 64;
+    road->in_arena = arena != NULL;
+    memset(&road->track, 0, sizeof(TrackStream)); // nothing for free_road to stop or free yet
+
+    // start with empty road, obstacles will spawn in the update function
+    const size_t rows_size = sizeof(uint64_t) * height * road->words_per_row;
+    road->rows = arena != NULL ? arena_alloc(arena, rows_size) : malloc(rows_size);
+    if (road->rows == NULL) {
+        free_road(road);
+        return NULL;
+    }
+    memset(road->rows, 0, rows_size);
+    road->top = 0;
+
+    road->car_x = width / 2;
+    road->car_y = height - 1;
+    road->crashed = 0;
+    road->num_obstacles = 0;
+    road->despawned = 0;
+
+    if (track_stream_init(&road->track, arena, width, seed, arena == NULL) == -1) {
+        free_road(road);
+        return NULL;
+    }
+    return road;
+}
+
+void free_road(Road* road) {
+    if (road == NULL)
+        return;
+    track_stream_destroy(&road->track);
+    if (!road->in_arena) {
+        free(road->rows);
+        free(road);
+    }
+}
+
+static int popcount_row(const Road* road, const uint64_t* row) {
+    int count = 0;
+    for (int w = 0; w < road->words_per_row; w++)
+        count += __builtin_popcountll(row[w]);
+    return count;
+}
+
+// the bottom row leaves the road and its slot in the ring becomes the new, empty top row
+static uint64_t* scroll_down(Road* road) {
+    uint64_t* bottom = road_row(road, road->height - 1);
+    road->despawned = popcount_row(road, bottom);
+    road->num_obstacles -= road->despawned;
+
+    road->top = road->top == 0 ? road->height - 1 : road->top - 1;
+    memset(bottom, 0, sizeof(uint64_t) * road->words_per_row);
+    return bottom;
+}
+
+// the next row of the track becomes the top row, returns 1 if it has any obstacle
+static int spawn_track_row(Road* road, uint64_t* top_row) {
+    memcpy(top_row, track_next_row(&road->track), sizeof(uint64_t) * road->words_per_row);
+    const int spawned = popcount_row(road, top_row);
+    road->num_obstacles += spawned;
+    return spawned > 0;
+}
+
+int racing_steer(const Road* road, const int car_x, const int direction) {
+    const int next_x = car_x + direction;
+    if (next_x < 0 || next_x >= road->width || road_has_obstacle(road, next_x, road->car_y))
+        return car_x;
+    return next_x;
+}
+
+int racing_advance(Road* road) {
+    int events = 0;
+    uint64_t* top_row = scroll_down(road);
+    if (road->despawned > 0)
+        events |= RACING_OBSTACLE_DESPAWNED;
+    // nothing spawns on the car's row, so a collision check can come before or after this
+    if (spawn_track_row(road, top_row))
+        events |= RACING_OBSTACLE_SPAWNED;
+    return events;
+}
+
+int racing_step(Road* road, const int direction) {
+    int events = 0;
+
+    const int next_x = racing_steer(road, road->car_x, direction);
+    if (next_x != road->car_x) {
+        road->car_x = next_x;
+        events |= RACING_CAR_MOVED;
+    }
+
+    events |= racing_advance(road);
+
+    // whatever was one row above the car is now on the car's row
+    if (road_has_obstacle(road, road->car_x, road->car_y)) {
+        road->crashed = 1;
+        events |= RACING_COLLISION;
+    }
+    return events;
+}
+
+uint64_t racing_hash(const Road* road) {
+    uint64_t hash = hash_init;
+    // in screen order, where the ring starts doesn't matter
+    for (int y = 0; y < road->height; y++)
+        hash = hash_bytes(hash, road_row(road, y), sizeof(uint64_t) * road->words_per_row);
+    hash = hash_int(hash, road->car_x);
+    hash = hash_int(hash, road->crashed);
+    hash = hash_int(hash, road->num_obstacles);
+    // the rows still to come only depend on the seed and how far down the track the road is
+    hash = hash_int(hash, (long long) road->track.generator.seed);
+    return hash_int(hash, road->track.rows_taken);
+}
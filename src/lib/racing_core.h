@@ -0,0 +1,84 @@
+#ifndef VGC_RACING_CORE_H
+#define VGC_RACING_CORE_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "track.h"
+
+/*  Racing rules without any terminal code.
+ *  The road is a ring buffer of rows, each row a bitmask of obstacle lanes. Scrolling the road down is moving the
+ *  ring's top index, spawning is copying the next row of the track (lib/track.h) into the new top row and the
+ *  collision check is one bit test on the car's row, so a step costs O(lanes / 64) words instead of touching every
+ *  pixel. Front ends diff two frames by XORing rows.
+ */
+
+#define char_car 'O'
+#define char_obstacle '#'
+#define char_crash 'X'
+#define char_road ' '
+
+// size of the road the game uses, the core works with any size
+#define road_width_inner 7
+#define road_height 25
+
+#define right 1
+#define left (-1)
+#define neutral 0
+
+// events returned by racing_step
+#define RACING_CAR_MOVED          1
+#define RACING_COLLISION          2
+#define RACING_OBSTACLE_DESPAWNED 4 // road->despawned tells how many
+#define RACING_OBSTACLE_SPAWNED   8
+
+typedef struct {
+    int width;  // lanes
+    int height; // rows
+    int words_per_row;
+
+    uint64_t* rows; // height rows of words_per_row words, bit x of a row is lane x
+    int top;        // ring index of the row at y = 0
+
+    int car_x;
+    int car_y; // constant, the bottom row
+    int crashed;
+
+    int num_obstacles;
+    int despawned; // obstacles that left the road in the last step
+
+    TrackStream track; // where the new rows come from, made ahead on its own thread unless the road is in an arena
+
+    int in_arena; // allocated with create_road_in, the arena owns the memory
+} Road;
+
+// starts the track generator thread, free_road stops it
+Road* create_initial_road(int width, int height, unsigned long seed);
+// the road and its rows in the arena, free_road leaves them alone and arena_reset reclaims them.
+// The track is made on the calling thread, it is the same track create_initial_road makes for the seed
+Road* create_road_in(Arena* arena, int width, int height, unsigned long seed);
+void free_road(Road* road);
+
+int racing_step(Road* road, int direction);
+
+// racing_step in two halves, for several cars on one road (the multiplayer server). Steer every car first,
+// then advance the road once, then a car has crashed if road_has_obstacle(road, its x, road->car_y)
+int racing_steer(const Road* road, int car_x, int direction); // returns the car's new lane
+int racing_advance(Road* road); // scrolls one row and spawns the new top row, returns the RACING_OBSTACLE_ events
+
+// hash of everything the next steps depend on, two roads with the same hash play on the same
+uint64_t racing_hash(const Road* road);
+
+// the words of row y, y = 0 is the top of the road
+static inline uint64_t* road_row(const Road* road, const int y) {
+    int idx = road->top + y;
+    if (idx >= road->height)
+        idx -= road->height;
+    return road->rows + (long) idx * road->words_per_row;
+}
+
+static inline int road_has_obstacle(const Road* road, const int x, const int y) {
+    return (road_row(road, y)[x >> 6] >> (x & 63)) & 1;
+}
+
+#endif
@@ -0,0 +1,557 @@
+#define _GNU_SOURCE // program_invocation_short_name
+#include "render.h"
+#include "perf.h"
+#include "spectate.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ncurses.h>
+#include <term.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+void init_terminal(void) {
+    initscr();             // Start ncurses mode
+    cbreak();              // Disable line buffering
+    keypad(stdscr, TRUE);  // Enable arrow keys
+    set_escdelay(25);      // how long a lone ESC waits for the rest of a sequence, a whole second by default
+    noecho();              // Don't display typed characters
+    nodelay(stdscr, TRUE); // make getch non-blocking
+    curs_set(0);           // Hide the cursor
+}
+
+// the longest a raw frame can get: a cursor move and a character for every cell
+static size_t raw_frame_size(const int cols, const int rows) {
+    return (size_t) cols * rows * 12 + 64;
+}
+
+static Renderer* new_renderer(const int cols, const int rows, const int headless) {
+    Renderer* r = malloc(sizeof(Renderer));
+    if (r == NULL)
+        return NULL;
+
+    const int cells = cols * rows;
+    r->cols = cols;
+    r->rows = rows;
+    r->front = malloc(cells);
+    r->back = malloc(cells);
+    r->dirty = malloc(sizeof(int) * cells);
+    r->is_dirty = calloc(cells, 1);
+    r->num_dirty = 0;
+    if (r->front == NULL || r->back == NULL || r->dirty == NULL || r->is_dirty == NULL) {
+        free(r->front);
+        free(r->back);
+        free(r->dirty);
+        free(r->is_dirty);
+        free(r);
+        return NULL;
+    }
+
+    // a fresh ncurses screen is blank, so both buffers start as spaces and only real content gets sent
+    memset(r->front, ' ', cells);
+    memset(r->back, ' ', cells);
+
+    // ncurses writes straight to the tty fd, the per-thread io accounting is the only place the real byte count shows up
+    r->io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    r->headless = headless;
+
+    // what the terminal shows goes to shared memory as well, for vgc-watch. Named after the binary, which is the
+    // game's name for spawned games
+    r->spectate = NULL;
+    if (!headless && getenv("VGC_SPECTATE") != NULL)
+        r->spectate = spectate_start(program_invocation_short_name, cols, rows);
+
+    r->raw = !headless && getenv("VGC_OUTPUT") != NULL && strcmp(getenv("VGC_OUTPUT"), "raw") == 0;
+    r->cursor_x = -1;
+    r->cursor_y = -1;
+    r->raw_refresh = 1;
+    r->newline_is_crlf = 0;
+    const char* rep = r->raw ? tigetstr("rep") : NULL;
+    r->has_rep = rep != NULL && rep != (char*) -1;
+    r->out = r->raw ? malloc(raw_frame_size(cols, rows)) : NULL;
+    if (r->raw && r->out == NULL) {
+        free_renderer(r);
+        return NULL;
+    }
+
+    memset(&r->stats, 0, sizeof(RenderStats));
+    return r;
+}
+
+Renderer* create_renderer(const int cols, const int rows) {
+    return new_renderer(cols, rows, 0);
+}
+
+Renderer* create_headless_renderer(const int cols, const int rows) {
+    return new_renderer(cols, rows, 1);
+}
+
+void free_renderer(Renderer* r) {
+    if (r != NULL) {
+        if (r->io_fd != -1)
+            close(r->io_fd);
+        spectate_stop(r->spectate);
+        free(r->front);
+        free(r->back);
+        free(r->dirty);
+        free(r->is_dirty);
+        free(r->out);
+        free(r);
+    }
+}
+
+static void mark_dirty(Renderer* r, const int idx) {
+    if (!r->is_dirty[idx]) {
+        r->is_dirty[idx] = 1;
+        r->dirty[r->num_dirty++] = idx;
+    }
+}
+
+void renderer_put(Renderer* r, const int x, const int y, const char c) {
+    if (x < 0 || x >= r->cols || y < 0 || y >= r->rows)
+        return;
+
+    const int idx = x + y * r->cols;
+    if (r->back[idx] == c)
+        return;
+    r->back[idx] = c;
+    mark_dirty(r, idx);
+}
+
+void renderer_print(Renderer* r, const int x, const int y, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    for (int i = 0; line[i] != '\0'; i++)
+        renderer_put(r, x + i, y, line[i]);
+}
+
+void renderer_clear(Renderer* r) {
+    for (int i = 0; i < r->cols * r->rows; i++) {
+        if (r->back[i] != ' ') {
+            r->back[i] = ' ';
+            mark_dirty(r, i);
+        }
+    }
+}
+
+void renderer_invalidate(Renderer* r) {
+    // '\0' never matches a real cell, so every cell goes out on the next flush
+    memset(r->front, '\0', r->cols * r->rows);
+    for (int i = 0; i < r->cols * r->rows; i++)
+        mark_dirty(r, i);
+    clearok(curscr, TRUE);
+    r->raw_refresh = 1;
+}
+
+int terminal_in_foreground(void) {
+    return !isatty(STDIN_FILENO) || tcgetpgrp(STDIN_FILENO) == getpgrp();
+}
+
+static int quit_pending(void) {
+    sigset_t pending;
+    sigpending(&pending);
+    return sigismember(&pending, SIGINT) || sigismember(&pending, SIGTERM);
+}
+
+int renderer_suspend(Renderer* r) {
+    def_prog_mode();
+    endwin();
+    // bg continues us without the terminal, touching it from the background would only stop us again
+    do {
+        kill(getpid(), SIGSTOP);
+    } while (!terminal_in_foreground() && !quit_pending());
+    if (!terminal_in_foreground())
+        return 0;
+
+    reset_prog_mode();
+    renderer_resize_to_terminal(r); // it may have been resized while we were stopped
+    renderer_invalidate(r);
+    renderer_flush(r);
+    return 1;
+}
+
+void renderer_resize_to_terminal(Renderer* r) {
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == -1 || size.ws_col == 0 || size.ws_row == 0)
+        return;
+    resizeterm(size.ws_row, size.ws_col);
+
+    const int cols = size.ws_col;
+    const int rows = size.ws_row;
+    char* back = malloc(cols * rows);
+    char* front = malloc(cols * rows);
+    int* dirty = malloc(sizeof(int) * cols * rows);
+    char* is_dirty = calloc(cols * rows, 1);
+    char* out = r->raw ? malloc(raw_frame_size(cols, rows)) : NULL;
+    if (back == NULL || front == NULL || dirty == NULL || is_dirty == NULL || (r->raw && out == NULL)) {
+        // drawing goes on at the old size, what doesn't fit the terminal anymore is cut off
+        free(back);
+        free(front);
+        free(dirty);
+        free(is_dirty);
+        free(out);
+        renderer_invalidate(r);
+        return;
+    }
+
+    memset(back, ' ', cols * rows);
+    for (int y = 0; y < rows && y < r->rows; y++)
+        for (int x = 0; x < cols && x < r->cols; x++)
+            back[x + y * cols] = r->back[x + y * r->cols];
+
+    free(r->front);
+    free(r->back);
+    free(r->dirty);
+    free(r->is_dirty);
+    free(r->out);
+    r->cols = cols;
+    r->rows = rows;
+    r->back = back;
+    r->front = front;
+    r->dirty = dirty;
+    r->is_dirty = is_dirty;
+    r->num_dirty = 0;
+    r->out = out;
+
+    renderer_invalidate(r);
+}
+
+static long bytes_written_so_far(const Renderer* r) {
+    if (r->io_fd == -1)
+        return 0;
+
+    char buf[512];
+    const ssize_t n = pread(r->io_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+
+    const char* wchar = strstr(buf, "wchar:");
+    return wchar == NULL ? 0 : strtol(wchar + 6, NULL, 10);
+}
+
+// ---- raw output ----
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+// from column c to x on row y, x >= c
+static int raw_forward(const Renderer* r, char* out, const int c, const int x, const int y) {
+    const int n = x - c;
+    if (n == 0)
+        return 0;
+    // printing what is already there is no longer than ESC [ n C for up to 4 cells
+    if (n <= 4) {
+        memcpy(out, r->front + y * r->cols + c, n);
+        return n;
+    }
+    return sprintf(out, "\x1b[%dC", n);
+}
+
+static int raw_horizontal(const Renderer* r, char* out, const int c, const int x, const int y) {
+    if (x >= c)
+        return raw_forward(r, out, c, x, y);
+
+    char back[16];
+    int back_len;
+    if (c - x <= 3) {
+        memset(back, '\b', c - x);
+        back_len = c - x;
+    }
+    else
+        back_len = sprintf(back, "\x1b[%dD", c - x);
+
+    // or back to the start of the line and forward from there
+    char forward[16];
+    const int forward_len = raw_forward(r, forward, 0, x, y);
+    if (1 + forward_len < back_len) {
+        out[0] = '\r';
+        memcpy(out + 1, forward, forward_len);
+        return 1 + forward_len;
+    }
+    memcpy(out, back, back_len);
+    return back_len;
+}
+
+// the shortest of an absolute move, a vertical move and then a horizontal one, or newlines and then a horizontal one
+static int raw_move(Renderer* r, char* out, const int x, const int y) {
+    const int cx = r->cursor_x;
+    const int cy = r->cursor_y;
+    if (cx == x && cy == y)
+        return 0;
+
+    char best[64];
+    int best_len = x == 0 ? (y == 0 ? sprintf(best, "\x1b[H") : sprintf(best, "\x1b[%dH", y + 1))
+                          : sprintf(best, "\x1b[%d;%dH", y + 1, x + 1);
+
+    if (cx != -1) {
+        char move[64];
+        int len = 0;
+        if (y > cy && y - cy <= 3 && !r->newline_is_crlf) {
+            memset(move, '\n', y - cy); // a bare line feed keeps the column
+            len = y - cy;
+        }
+        else if (y > cy)
+            len = sprintf(move, "\x1b[%dB", y - cy);
+        else if (y < cy)
+            len = sprintf(move, y == cy - 1 ? "\x1bM" : "\x1b[%dA", cy - y);
+        len += raw_horizontal(r, move + len, cx, x, y);
+        if (len < best_len) {
+            memcpy(best, move, len);
+            best_len = len;
+        }
+
+        if (y > cy && y - cy <= 4 && r->newline_is_crlf) {
+            len = y - cy;
+            memset(move, '\n', len);
+            len += raw_forward(r, move + len, 0, x, y);
+            if (len < best_len) {
+                memcpy(best, move, len);
+                best_len = len;
+            }
+        }
+    }
+    memcpy(out, best, best_len);
+    return best_len;
+}
+
+// the cells, with runs of one character sent once and repeated by the terminal
+static int raw_cells(const Renderer* r, char* out, const char* cells, const int count) {
+    int n = 0;
+    for (int i = 0; i < count;) {
+        int run = 1;
+        while (i + run < count && cells[i + run] == cells[i])
+            run++;
+        char repeat[16];
+        const int repeat_len = r->has_rep ? sprintf(repeat, "\x1b[%db", run - 1) : 0;
+        if (r->has_rep && run > 1 + repeat_len) {
+            out[n++] = cells[i];
+            memcpy(out + n, repeat, repeat_len);
+            n += repeat_len;
+        }
+        else {
+            memcpy(out + n, cells + i, run);
+            n += run;
+        }
+        i += run;
+    }
+    return n;
+}
+
+static void write_all(const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(STDOUT_FILENO, data, size);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        data += n;
+        size -= n;
+    }
+}
+
+static int cells_differing(const char* a, const char* b, const int n) {
+    int count = 0;
+    for (int i = 0; i < n; i++)
+        count += a[i] != b[i];
+    return count;
+}
+
+/*  the road moving down a row is a scroll of the region it is in, a few bytes instead of every obstacle again.
+ *  Looks for the longest block of rows that shows what the row above (or below) showed before. If scrolling it pays
+ *  off, the scroll goes into r->out, the front buffer is shifted the same way and whatever still differs after the
+ *  shift is marked dirty. Called before the flush looks at the dirty cells, returns the bytes written to r->out
+ */
+static size_t raw_scroll(Renderer* r) {
+    const int cols = r->cols;
+    int best_top = 0;
+    int best_bottom = 0;
+    int best_direction = 0;
+    int best_saved = 0;
+
+    for (int direction = -1; direction <= 1; direction += 2) {
+        for (int y = 0; y < r->rows;) {
+            int end = y;
+            int saved = 0;
+            while (end < r->rows && end - direction >= 0 && end - direction < r->rows
+                   && memcmp(r->back + end * cols, r->front + (end - direction) * cols, cols) == 0) {
+                saved += cells_differing(r->back + end * cols, r->front + end * cols, cols);
+                end++;
+            }
+            if (end == y) {
+                y++;
+                continue;
+            }
+            if (saved > best_saved) {
+                // down: rows y - 1 to end - 1 move down one and y - 1 is blank, up: y + 1 to end move up one
+                best_top = direction == 1 ? y - 1 : y;
+                best_bottom = direction == 1 ? end - 1 : end;
+                best_direction = direction;
+                best_saved = saved;
+            }
+            y = end;
+        }
+    }
+    if (best_saved == 0)
+        return 0;
+
+    const int full_screen = best_top == 0 && best_bottom == r->rows - 1;
+    const int cursor_x = r->cursor_x;
+    const int cursor_y = r->cursor_y;
+    int n = 0;
+    if (!full_screen) {
+        n += sprintf(r->out + n, "\x1b[%d;%dr", best_top + 1, best_bottom + 1);
+        r->cursor_x = r->cursor_y = 0; // setting the region homes the cursor
+    }
+    // reverse index at the top of the region scrolls it down, index at the bottom scrolls it up
+    const int row = best_direction == 1 ? best_top : best_bottom;
+    n += raw_move(r, r->out + n, 0, row);
+    n += sprintf(r->out + n, best_direction == 1 ? "\x1bM" : "\x1b" "D");
+    r->cursor_x = 0;
+    r->cursor_y = row;
+    if (!full_screen) {
+        n += sprintf(r->out + n, "\x1b[r"); // also homes the cursor
+        r->cursor_y = 0;
+    }
+    // each differing cell costs at least its own byte, so the scroll has to be shorter than that
+    if (n >= best_saved) {
+        r->cursor_x = cursor_x;
+        r->cursor_y = cursor_y;
+        return 0;
+    }
+
+    const int region_rows = best_bottom - best_top;
+    char* region = r->front + best_top * cols;
+    if (best_direction == 1) {
+        memmove(region + cols, region, (size_t) region_rows * cols);
+        memset(region, ' ', cols);
+    }
+    else {
+        memmove(region, region + cols, (size_t) region_rows * cols);
+        memset(region + (size_t) region_rows * cols, ' ', cols);
+    }
+    for (int i = best_top * cols; i < (best_bottom + 1) * cols; i++) {
+        if (r->front[i] != r->back[i])
+            mark_dirty(r, i);
+    }
+    return n;
+}
+
+/*  the changed cells of this frame are r->dirty[0..changed), already in the front buffer. In screen order, the cells
+ *  of a row go out in spans, joining two changed cells when rewriting the ones between them is cheaper than moving
+ *  over them, and every span is one cursor move and its characters
+ */
+static void raw_flush(Renderer* r, const int changed, size_t n) {
+    const int after_clear = r->raw_refresh;
+    if (r->raw_refresh) {
+        // ncurses clears the screen and puts the terminal modes back, its own screen is blank so that's all it sends
+        refresh();
+        struct termios modes;
+        r->newline_is_crlf = tcgetattr(STDOUT_FILENO, &modes) == 0 && (modes.c_oflag & OPOST) && (modes.c_oflag & ONLCR);
+        r->cursor_x = -1;
+        r->cursor_y = -1;
+        r->raw_refresh = 0;
+    }
+
+    qsort(r->dirty, changed, sizeof(int), compare_ints);
+    for (int i = 0; i < changed;) {
+        // on a cleared screen the blank cells are already right
+        if (after_clear && r->front[r->dirty[i]] == ' ') {
+            i++;
+            continue;
+        }
+        const int y = r->dirty[i] / r->cols;
+        const int x = r->dirty[i] % r->cols;
+        int last = i;
+        for (int j = i + 1; j < changed && r->dirty[j] / r->cols == y && r->dirty[j] - r->dirty[last] - 1 <= 4; j++) {
+            if (!after_clear || r->front[r->dirty[j]] != ' ')
+                last = j;
+        }
+        const int end_x = r->dirty[last] % r->cols;
+
+        n += raw_move(r, r->out + n, x, y);
+        n += raw_cells(r, r->out + n, r->front + y * r->cols + x, end_x - x + 1);
+        // past the last column the cursor waits to wrap, where it really is depends on the terminal
+        r->cursor_x = end_x + 1 < r->cols ? end_x + 1 : -1;
+        r->cursor_y = y;
+        i = last + 1;
+    }
+    write_all(r->out, n);
+}
+
+void renderer_flush(Renderer* r) {
+    r->stats.cells_changed = 0;
+    r->stats.bytes_written = 0;
+    if (r->num_dirty == 0)
+        return; // nothing drawn, and nothing in the trace either, an idle wakeup isn't a frame
+    trace_event(TRACE_RENDER_BEGIN, 0);
+
+    // a scroll found here already changed the front buffer, the loop below only sees what is left
+    const size_t scroll_bytes = r->raw && !r->raw_refresh ? raw_scroll(r) : 0;
+
+    int changed = 0;
+    for (int i = 0; i < r->num_dirty; i++) {
+        const int idx = r->dirty[i];
+        r->is_dirty[idx] = 0;
+
+        // written and then written back within the same frame, nothing to send
+        if (r->front[idx] == r->back[idx])
+            continue;
+
+        if (!r->headless && !r->raw)
+            mvaddch(idx / r->cols, idx % r->cols, r->back[idx]);
+        r->front[idx] = r->back[idx];
+        r->dirty[changed++] = idx; // the front of the list becomes the cells that really changed, for spectators
+    }
+    r->num_dirty = 0;
+
+    r->stats.cells_changed = changed;
+    if (changed == 0 && scroll_bytes == 0) {
+        trace_event(TRACE_RENDER_END, 0);
+        return;
+    }
+
+    long bytes = 0;
+    if (!r->headless) {
+        const long before = bytes_written_so_far(r);
+        if (r->raw)
+            raw_flush(r, changed, scroll_bytes);
+        else
+            refresh();
+        bytes = bytes_written_so_far(r) - before;
+    }
+    // after the terminal has its frame, so spectators never delay the player
+    if (r->spectate != NULL)
+        spectate_publish(r->spectate, r->front, r->cols, r->rows, r->dirty, changed);
+
+    r->stats.frames++;
+    r->stats.bytes_written = bytes;
+    r->stats.total_cells_changed += changed;
+    r->stats.total_bytes_written += bytes;
+    perf_frame(changed, bytes);
+    trace_event(TRACE_RENDER_END, bytes);
+}
+
+void renderer_report_stats(const Renderer* r, const char* name, FILE* out) {
+    if (r == NULL || getenv("VGC_STATS") == NULL)
+        return;
+
+    const RenderStats* s = &r->stats;
+    fprintf(out, "%s: %ld frames, %ld cells changed, %ld bytes written", name, s->frames, s->total_cells_changed,
+            s->total_bytes_written);
+    if (s->frames > 0)
+        fprintf(out, " (%.1f cells, %.1f bytes per frame)", (double) s->total_cells_changed / s->frames,
+                (double) s->total_bytes_written / s->frames);
+    fprintf(out, "\n");
+}
@@ -0,0 +1,84 @@
+#ifndef VGC_RENDER_H
+#define VGC_RENDER_H
+
+#include <stdio.h>
+
+#include "spectate.h"
+
+/*  Frame-batched renderer shared by the console and every game.
+ *  Writes only go to the back buffer and mark the cell dirty, nothing reaches the terminal until renderer_flush(),
+ *  which sends the changed cells and does a single refresh. Call it once per tick.
+ *  With VGC_OUTPUT=raw in the environment the flush skips ncurses and encodes the frame itself, for slow links:
+ *  the cheapest cursor move to each run of changed cells, runs of one character as a repeat, one write() per frame.
+ */
+
+typedef struct {
+    long frames;              // flushes that actually sent something to the terminal
+    long cells_changed;       // cells sent in the last frame
+    long bytes_written;       // bytes written to the terminal in the last frame
+    long total_cells_changed;
+    long total_bytes_written;
+} RenderStats;
+
+typedef struct {
+    int cols;
+    int rows;
+
+    char* front; // what the terminal is currently showing
+    char* back;  // what the next frame will show
+
+    // indices of cells written since the last flush, is_dirty keeps them unique
+    int* dirty;
+    char* is_dirty;
+    int num_dirty;
+
+    int io_fd; // /proc/thread-self/io of the thread that flushes, used to count bytes written
+    int headless; // no terminal behind it, a flush only moves the cells to the front buffer and counts them
+    Spectate* spectate; // set with VGC_SPECTATE in the environment, every flushed frame is published there (lib/spectate.h)
+
+    // VGC_OUTPUT=raw: renderer_flush writes the escape sequences itself, one write() per frame, ncurses only sets up
+    // the terminal and reads the keys
+    int raw;
+    int cursor_x; // where the last raw frame left the cursor, -1 if we don't know
+    int cursor_y;
+    int raw_refresh; // the screen was cleared or handed to someone else, ncurses sets it up again before the next frame
+    int newline_is_crlf; // the tty turns \n into \r\n, so \n moves to the start of the next line
+    int has_rep; // the terminal repeats the previous character with ESC [ n b
+    char* out; // the raw frame being built
+    RenderStats stats;
+} Renderer;
+
+// initscr + the usual settings every binary used to repeat (cbreak, noecho, non-blocking getch, hidden cursor)
+void init_terminal(void);
+
+Renderer* create_renderer(int cols, int rows);
+// for running without a terminal (headless replays), nothing is ever sent and bytes_written stays 0
+Renderer* create_headless_renderer(int cols, int rows);
+void free_renderer(Renderer* r);
+
+void renderer_put(Renderer* r, int x, int y, char c);
+void renderer_print(Renderer* r, int x, int y, const char* format, ...);
+void renderer_clear(Renderer* r);
+
+// forget what the terminal shows and repaint every cell on the next flush (after a child or resize messed it up)
+void renderer_invalidate(Renderer* r);
+
+// after SIGWINCH: resize ncurses and the buffers to the new terminal size, keeping the overlapping content
+void renderer_resize_to_terminal(Renderer* r);
+
+void renderer_flush(Renderer* r);
+
+/*  ctrl+z: hands the terminal back in its normal state and stops the process, until fg or the console continues it.
+ *  Back in the foreground it takes the terminal again and repaints the whole screen from the back buffer, without
+ *  asking the game. Returns 0 instead if it was continued without the terminal and with SIGINT or SIGTERM waiting,
+ *  which is how the console ends a suspended game; the screen is left alone then
+ */
+int renderer_suspend(Renderer* r);
+
+// we are in the terminal's foreground process group, or there is no terminal at all
+int terminal_in_foreground(void);
+
+// prints the counters if VGC_STATS is set in the environment, call after endwin()
+void renderer_report_stats(const Renderer* r, const char* name, FILE* out);
+
+#endif
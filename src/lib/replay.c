@@ -0,0 +1,172 @@
+#include "replay.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void write_varint(FILE* file, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int) (value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int) value, file);
+}
+
+// -1 if the data ends in the middle of a varint
+static int read_varint(const unsigned char** p, const unsigned char* end, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        const unsigned char byte = *(*p)++;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return 0;
+    }
+    return -1;
+}
+
+ReplayRecorder* start_recording(const char* path, const char* game, const uint64_t seed, const int board_width,
+                                const int board_height) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return NULL;
+
+    ReplayHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, replay_magic, sizeof(header.magic));
+    header.version = replay_version;
+    header.seed = seed;
+    header.board_width = (uint16_t) board_width;
+    header.board_height = (uint16_t) board_height;
+    snprintf(header.game, sizeof(header.game), "%s", game);
+    fwrite(&header, sizeof(header), 1, file);
+
+    ReplayRecorder* recorder = malloc(sizeof(ReplayRecorder));
+    if (recorder == NULL) {
+        fclose(file);
+        errno = ENOMEM;
+        return NULL;
+    }
+    recorder->file = file;
+    recorder->last_tick = 0;
+    return recorder;
+}
+
+void record_key(ReplayRecorder* recorder, const unsigned long tick, const int key) {
+    // stdio buffers it, a whole session is a few writes
+    write_varint(recorder->file, tick - recorder->last_tick);
+    write_varint(recorder->file, (uint64_t) key + 1);
+    recorder->last_tick = tick;
+}
+
+int finish_recording(ReplayRecorder* recorder, const unsigned long ticks, const uint64_t final_hash) {
+    write_varint(recorder->file, ticks - recorder->last_tick);
+    write_varint(recorder->file, 0);
+    fwrite(&final_hash, sizeof(final_hash), 1, recorder->file);
+
+    const int failed = ferror(recorder->file);
+    const int closed = fclose(recorder->file);
+    free(recorder);
+    return failed || closed != 0 ? -1 : 0;
+}
+
+static unsigned char* read_file(const char* path, long* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    rewind(file);
+    unsigned char* data = malloc(*size > 0 ? *size : 1);
+    if (data == NULL)
+        errno = ENOMEM;
+    else if (fread(data, 1, *size, file) != (size_t) *size) {
+        free(data);
+        data = NULL;
+        errno = EIO;
+    }
+    fclose(file);
+    return data;
+}
+
+Replay* load_replay(const char* path) {
+    long size;
+    unsigned char* data = read_file(path, &size);
+    if (data == NULL)
+        return NULL;
+
+    const ReplayHeader* header = (const ReplayHeader*) data;
+    if (size < (long) sizeof(ReplayHeader) || memcmp(header->magic, replay_magic, sizeof(header->magic)) != 0
+        || header->version != replay_version) {
+        free(data);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Replay* replay = calloc(1, sizeof(Replay));
+    if (replay == NULL) {
+        free(data);
+        errno = ENOMEM;
+        return NULL;
+    }
+    replay->seed = header->seed;
+    replay->board_width = header->board_width;
+    replay->board_height = header->board_height;
+    snprintf(replay->game, sizeof(replay->game), "%.*s", (int) sizeof(header->game), header->game);
+
+    // every key takes at least 2 bytes, that bounds how many there can be
+    const long max_keys = (size - (long) sizeof(ReplayHeader)) / 2 + 1;
+    replay->key_ticks = malloc(sizeof(unsigned long) * max_keys);
+    replay->keys = malloc(sizeof(int) * max_keys);
+    if (replay->key_ticks == NULL || replay->keys == NULL) {
+        free(data);
+        free_replay(replay);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    const unsigned char* p = data + sizeof(ReplayHeader);
+    const unsigned char* end = data + size;
+    unsigned long tick = 0;
+    int complete = 0;
+    while (!complete) {
+        uint64_t delta, key;
+        if (read_varint(&p, end, &delta) == -1 || read_varint(&p, end, &key) == -1)
+            break;
+        tick += delta;
+        if (key == 0) {
+            // the end of the log, only the final hash is left
+            if (end - p >= (long) sizeof(uint64_t)) {
+                memcpy(&replay->final_hash, p, sizeof(uint64_t));
+                replay->end_tick = tick;
+                complete = 1;
+            }
+            break;
+        }
+        replay->key_ticks[replay->num_keys] = tick;
+        replay->keys[replay->num_keys] = (int) (key - 1);
+        replay->num_keys++;
+    }
+    free(data);
+
+    if (!complete) {
+        free_replay(replay);
+        errno = EINVAL;
+        return NULL;
+    }
+    return replay;
+}
+
+void free_replay(Replay* replay) {
+    if (replay != NULL) {
+        free(replay->key_ticks);
+        free(replay->keys);
+        free(replay);
+    }
+}
+
+int replay_next_key(Replay* replay, const unsigned long tick) {
+    if (replay->next_key == replay->num_keys || replay->key_ticks[replay->next_key] > tick)
+        return -1;
+    return replay->keys[replay->next_key++];
+}
@@ -0,0 +1,63 @@
+#ifndef VGC_REPLAY_H
+#define VGC_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*  Input recording for deterministic replays. A game is a pure function of its seed, its board size and of which keys
+ *  reached it before which tick, so that is all a recording holds:
+ *
+ *      ReplayHeader | (varint ticks since the previous key, varint key + 1)... | varint ticks left, 0 | final hash
+ *
+ *  Varints are LEB128, so a key costs 2 bytes unless the player waited more than 127 ticks. The final hash is the
+ *  game's state hash after the last tick, a replay that ends on another hash went a different way.
+ */
+
+#define replay_magic "VGCREPLY"
+#define replay_version 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint16_t board_width; // 0 for a game whose board is always the same size, and in older recordings
+    uint16_t board_height;
+    uint64_t seed;
+    char game[32];
+} ReplayHeader;
+
+typedef struct {
+    FILE* file;
+    unsigned long last_tick;
+} ReplayRecorder;
+
+typedef struct {
+    uint64_t seed;
+    char game[32];
+    int board_width; // 0 if the recording doesn't say
+    int board_height;
+
+    // the keys in order, each with the tick it arrived before
+    unsigned long* key_ticks;
+    int* keys;
+    long num_keys;
+    long next_key;
+
+    unsigned long end_tick; // ticks the recorded game ran
+    uint64_t final_hash;
+} Replay;
+
+// NULL if the file can't be created. board_width and board_height are 0 for a game with a fixed board
+ReplayRecorder* start_recording(const char* path, const char* game, uint64_t seed, int board_width, int board_height);
+// the key reached the game after tick ticks and before the next one
+void record_key(ReplayRecorder* recorder, unsigned long tick, int key);
+// writes the end of the log and frees the recorder, returns -1 if anything couldn't be written
+int finish_recording(ReplayRecorder* recorder, unsigned long ticks, uint64_t final_hash);
+
+// NULL with errno set if the file can't be read, EINVAL if it isn't a complete recording
+Replay* load_replay(const char* path);
+void free_replay(Replay* replay);
+
+// the next key that arrived before tick, -1 once there is none left for it
+int replay_next_key(Replay* replay, unsigned long tick);
+
+#endif
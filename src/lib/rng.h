@@ -0,0 +1,42 @@
+#ifndef VGC_RNG_H
+#define VGC_RNG_H
+
+#include <stdint.h>
+
+/*  Small seedable PRNG (xorshift64*) for the game cores. Unlike rand() it keeps its state in the game,
+ *  so a game is reproducible from its seed and many games can run side by side without sharing anything.
+ */
+
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static inline void rng_seed(Rng* rng, const uint64_t seed) {
+    // splitmix64 step, spreads small seeds like 1, 2, 3 over the whole state and never leaves it at 0
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    rng->state = z != 0 ? z : 1;
+}
+
+static inline uint64_t rng_next(Rng* rng) {
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// uniform in [0, n), using the high bits which are the good ones in xorshift*
+static inline uint32_t rng_below(Rng* rng, const uint32_t n) {
+    return (uint32_t) (((rng_next(rng) >> 32) * (uint64_t) n) >> 32);
+}
+
+// true with the given probability
+static inline int rng_chance(Rng* rng, const double probability) {
+    return (double) (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0) < probability;
+}
+
+#endif
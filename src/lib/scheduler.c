@@ -0,0 +1,147 @@
+#include "scheduler.h"
+#include "clock.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+Scheduler* create_scheduler(const int tick_hz, const int render_hz) {
+    Scheduler* s = malloc(sizeof(Scheduler));
+    if (s == NULL)
+        return NULL;
+
+    memset(s, 0, sizeof(Scheduler));
+    s->tick_ns = 1000000000ll / tick_hz;
+    s->render_ns = 1000000000ll / render_hz;
+    s->max_catch_up = 5;
+    s->start_ns = monotonic_ns();
+    scheduler_reset(s);
+    return s;
+}
+
+void free_scheduler(Scheduler* s) {
+    free(s);
+}
+
+long long scheduler_timer_period_ns(const Scheduler* s) {
+    return s->tick_ns < s->render_ns ? s->tick_ns : s->render_ns;
+}
+
+void scheduler_reset(Scheduler* s) {
+    s->accumulator_ns = 0;
+    s->last_time_ns = monotonic_ns();
+    s->last_render_ns = s->last_time_ns;
+}
+
+int scheduler_ticks_due(Scheduler* s) {
+    const long long now = monotonic_ns();
+    s->accumulator_ns += now - s->last_time_ns;
+    s->last_time_ns = now;
+
+    int due = 0;
+    while (s->accumulator_ns >= s->tick_ns) {
+        s->accumulator_ns -= s->tick_ns;
+
+        if (due == s->max_catch_up) {
+            s->dropped_ticks++;
+            perf_missed_deadline();
+            continue;
+        }
+        // what is left in the accumulator is how long ago this tick should have run
+        histogram_add(&s->jitter, s->accumulator_ns);
+        if (s->accumulator_ns >= s->tick_ns)
+            perf_missed_deadline();
+        due++;
+    }
+    s->ticks += due;
+    return due;
+}
+
+int scheduler_render_due(Scheduler* s) {
+    // half a timer period of slack so a wakeup a hair early doesn't skip a frame
+    if (s->last_time_ns - s->last_render_ns < s->render_ns - scheduler_timer_period_ns(s) / 2)
+        return 0;
+    s->last_render_ns = s->last_time_ns;
+    return 1;
+}
+
+void scheduler_begin_update(Scheduler* s) {
+    trace_event(TRACE_TICK_BEGIN, s->update.count);
+    s->update_start_ns = monotonic_ns();
+}
+
+void scheduler_end_update(Scheduler* s) {
+    const long long now = monotonic_ns();
+    histogram_add(&s->update, now - s->update_start_ns);
+    perf_tick(now - s->update_start_ns);
+    trace_event(TRACE_TICK_END, 0);
+}
+
+void scheduler_begin_render(Scheduler* s) {
+    s->render_start_ns = monotonic_ns();
+}
+
+void scheduler_end_render(Scheduler* s) {
+    s->frames++;
+    histogram_add(&s->render, monotonic_ns() - s->render_start_ns);
+}
+
+void histogram_add(Histogram* h, const long long ns) {
+    const long long us = ns / 1000;
+    int bucket = us <= 0 ? 0 : 64 - __builtin_clzll((unsigned long long) us);
+    if (bucket >= histogram_buckets)
+        bucket = histogram_buckets - 1;
+
+    h->buckets[bucket]++;
+    h->count++;
+    h->total_ns += ns;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+}
+
+long long histogram_percentile_ns(const Histogram* h, const double p) {
+    if (h->count == 0)
+        return 0;
+
+    const long rank = (long) (p * (h->count - 1)) + 1;
+    long seen = 0;
+    for (int i = 0; i < histogram_buckets; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            // the upper bound of the bucket, but never more than what was actually measured
+            const long long bound = (1ll << i) * 1000;
+            return bound < h->max_ns ? bound : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+void histogram_report(const Histogram* h, const char* label, FILE* out) {
+    if (h->count == 0) {
+        fprintf(out, "  %-7s no samples\n", label);
+        return;
+    }
+    fprintf(out, "  %-7s n=%ld mean=%.1fus p50<=%.1fus p99<=%.1fus max=%.1fus\n", label, h->count,
+            (double) h->total_ns / h->count / 1000.0, histogram_percentile_ns(h, 0.50) / 1000.0,
+            histogram_percentile_ns(h, 0.99) / 1000.0, h->max_ns / 1000.0);
+
+    fprintf(out, "         ");
+    for (int i = 0; i < histogram_buckets; i++) {
+        if (h->buckets[i] > 0)
+            fprintf(out, " <%lldus:%ld", 1ll << i, h->buckets[i]);
+    }
+    fprintf(out, "\n");
+}
+
+void scheduler_report_stats(const Scheduler* s, const char* name, FILE* out) {
+    if (s == NULL || getenv("VGC_STATS") == NULL)
+        return;
+
+    const double seconds = (monotonic_ns() - s->start_ns) / 1e9;
+    fprintf(out, "%s: %ld ticks in %.2fs (%.2f/s, configured %.2f/s), %ld dropped, %ld renders\n", name, s->ticks,
+            seconds, seconds > 0 ? s->ticks / seconds : 0.0, 1e9 / s->tick_ns, s->dropped_ticks, s->frames);
+    histogram_report(&s->jitter, "jitter", out);
+    histogram_report(&s->update, "update", out);
+    histogram_report(&s->render, "render", out);
+}
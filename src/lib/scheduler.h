@@ -0,0 +1,68 @@
+#ifndef VGC_SCHEDULER_H
+#define VGC_SCHEDULER_H
+
+#include <stdio.h>
+
+/*  Fixed-timestep scheduler. Elapsed time goes into an accumulator and every full tick period in it is one game tick,
+ *  so the tick rate stays exact however late the wakeups are, and the leftover is carried to the next wakeup instead
+ *  of being dropped. Rendering has its own rate. Tick jitter, update time and render time go into log2 histograms.
+ */
+
+#define histogram_buckets 32
+
+typedef struct {
+    long buckets[histogram_buckets]; // bucket i counts samples below 2^i microseconds (and at least 2^(i-1))
+    long count;
+    long long total_ns;
+    long long max_ns;
+} Histogram;
+
+typedef struct {
+    long long tick_ns;
+    long long render_ns;
+
+    long long accumulator_ns;
+    long long last_time_ns;
+    long long last_render_ns;
+    long long start_ns;
+    int max_catch_up; // more ticks than this in one wakeup are dropped instead of run in a burst
+
+    long ticks;
+    long dropped_ticks;
+    long frames;
+
+    long long update_start_ns;
+    long long render_start_ns;
+
+    Histogram jitter; // how long after its ideal time a tick actually ran
+    Histogram update;
+    Histogram render;
+} Scheduler;
+
+Scheduler* create_scheduler(int tick_hz, int render_hz);
+void free_scheduler(Scheduler* s);
+
+// the period the event loop timer should fire at, the shorter one of tick and render period
+long long scheduler_timer_period_ns(const Scheduler* s);
+
+// start over from now, e.g. after the process was stopped, so the missed time isn't caught up
+void scheduler_reset(Scheduler* s);
+
+// adds the time since the last call to the accumulator and returns how many ticks to run now
+int scheduler_ticks_due(Scheduler* s);
+int scheduler_render_due(Scheduler* s);
+
+void scheduler_begin_update(Scheduler* s);
+void scheduler_end_update(Scheduler* s);
+void scheduler_begin_render(Scheduler* s);
+void scheduler_end_render(Scheduler* s);
+
+void histogram_add(Histogram* h, long long ns);
+long long histogram_percentile_ns(const Histogram* h, double p);
+// two lines: count, mean and percentiles, then the non-empty buckets
+void histogram_report(const Histogram* h, const char* label, FILE* out);
+
+// prints the tick rate and the histograms if VGC_STATS is set in the environment, call after endwin()
+void scheduler_report_stats(const Scheduler* s, const char* name, FILE* out);
+
+#endif
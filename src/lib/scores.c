@@ -0,0 +1,304 @@
+#include "scores.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define queue_capacity 16 // games end a few times a minute at most, the writer empties it in milliseconds
+
+static ScoreRecord queue[queue_capacity];
+static int queued;
+static unsigned long submitted; // under lock, like everything above
+static unsigned long written;
+static int stopping;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;    // the writer, something was queued or it should stop
+static pthread_cond_t written_cond = PTHREAD_COND_INITIALIZER; // scores_sync, a batch is on disk
+
+static pthread_t writer;
+static int running;
+static char journal_file[256];
+
+const char* scores_path(void) {
+    const char* path = getenv("VGC_SCORES");
+    if (path != NULL && strcmp(path, "0") == 0)
+        return NULL;
+    return path != NULL && path[0] != '\0' ? path : "storage_vgc.scores";
+}
+
+static uint64_t record_checksum(const ScoreRecord* r) {
+    return hash_bytes(hash_init, r, offsetof(ScoreRecord, checksum));
+}
+
+static int record_valid(const ScoreRecord* r) {
+    return r->game[0] != '\0' && r->checksum == record_checksum(r);
+}
+
+static uint64_t index_checksum(const ScoreIndex* index) {
+    return hash_bytes(hash_init, index->games, index->num_games * sizeof(ScoreIndexGame));
+}
+
+static size_t index_size(const ScoreIndex* index) {
+    return offsetof(ScoreIndex, games) + index->num_games * sizeof(ScoreIndexGame);
+}
+
+// the index next to journal_path, or an empty one if it is missing or damaged, in which case it gets rebuilt
+static void load_index(const char* journal_path, ScoreIndex* index) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s.top", journal_path);
+    memset(index, 0, sizeof(ScoreIndex));
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+    const ssize_t n = read(fd, index, sizeof(ScoreIndex));
+    close(fd);
+    if (n < (ssize_t) offsetof(ScoreIndex, games) || memcmp(index->magic, SCORE_INDEX_MAGIC, 8) != 0
+        || index->version != SCORE_VERSION || index->num_games > score_max_games || (size_t) n != index_size(index)
+        || index->checksum != index_checksum(index))
+        memset(index, 0, sizeof(ScoreIndex));
+}
+
+// written beside the old one and renamed over it, a reader sees either of the two whole
+static void save_index(const char* journal_path, ScoreIndex* index) {
+    char path[300], tmp[310];
+    snprintf(path, sizeof(path), "%s.top", journal_path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    memcpy(index->magic, SCORE_INDEX_MAGIC, sizeof(index->magic));
+    index->version = SCORE_VERSION;
+    index->checksum = index_checksum(index);
+
+    const int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return;
+    const size_t size = index_size(index);
+    const int ok = write(fd, index, size) == (ssize_t) size && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) == -1)
+        unlink(tmp);
+}
+
+static ScoreIndexGame* index_game(ScoreIndex* index, const char* game) {
+    for (uint32_t i = 0; i < index->num_games; i++) {
+        if (strncmp(index->games[i].game, game, score_game_size) == 0)
+            return &index->games[i];
+    }
+    ScoreIndexGame* g;
+    if (index->num_games < score_max_games)
+        g = &index->games[index->num_games++];
+    else {
+        // full, the game played least makes room
+        g = &index->games[0];
+        for (uint32_t i = 1; i < index->num_games; i++) {
+            if (index->games[i].plays < g->plays)
+                g = &index->games[i];
+        }
+    }
+    memset(g, 0, sizeof(ScoreIndexGame));
+    memcpy(g->game, game, score_game_size);
+    return g;
+}
+
+static void merge_record(ScoreIndex* index, const ScoreRecord* r) {
+    ScoreIndexGame* g = index_game(index, r->game);
+    g->plays++;
+
+    // an equal score doesn't push out the one that was there first
+    uint32_t at = g->count;
+    while (at > 0 && g->top[at - 1].score < r->score)
+        at--;
+    if (at == score_top_n)
+        return;
+    const uint32_t moved = (g->count < score_top_n ? g->count : score_top_n - 1) - at;
+    memmove(&g->top[at + 1], &g->top[at], moved * sizeof(ScoreRecord));
+    g->top[at] = *r;
+    if (g->count < score_top_n)
+        g->count++;
+}
+
+// the records the index hasn't seen yet go into it. A damaged record is skipped for good, the journal never changes
+static void compact(const char* journal_path, const ScoreRecord* records, const uint64_t count) {
+    ScoreIndex index;
+    load_index(journal_path, &index);
+    if (index.covered > count)
+        memset(&index, 0, sizeof(index)); // the journal was replaced, start over from its first record
+
+    for (uint64_t i = index.covered; i < count; i++) {
+        if (record_valid(&records[i]))
+            merge_record(&index, &records[i]);
+    }
+    index.covered = count;
+    save_index(journal_path, &index);
+}
+
+static void sync_range(void* map, const size_t from, const size_t to) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t start = from / page * page;
+    msync((char*) map + start, to - start, MS_SYNC);
+}
+
+// runs with the journal flock()ed, another process may be appending to the same file
+static void append_records(const int fd, const ScoreRecord* batch, const int n) {
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return;
+    size_t size = st.st_size;
+    const int fresh = size < sizeof(ScoreJournalHeader);
+
+    uint64_t count = 0;
+    if (!fresh) {
+        ScoreJournalHeader header;
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, SCORE_MAGIC, 8) != 0
+            || header.version != SCORE_VERSION || header.record_size != sizeof(ScoreRecord))
+            return; // not ours, leave it alone
+        count = header.count;
+    }
+
+    // whole chunks, so the file only grows every score_chunk games
+    const uint64_t chunks = (count + n + score_chunk - 1) / score_chunk;
+    const size_t needed = sizeof(ScoreJournalHeader) + chunks * score_chunk * sizeof(ScoreRecord);
+    if (size < needed) {
+        if (posix_fallocate(fd, 0, needed) != 0)
+            return;
+        size = needed;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    ScoreJournalHeader* header = map;
+    ScoreRecord* records = (ScoreRecord*) (header + 1);
+    if (fresh) {
+        memcpy(header->magic, SCORE_MAGIC, sizeof(header->magic));
+        header->version = SCORE_VERSION;
+        header->record_size = sizeof(ScoreRecord);
+    }
+
+    // the records reach the disk before the count that makes them part of the journal
+    memcpy(&records[count], batch, n * sizeof(ScoreRecord));
+    const size_t first = sizeof(ScoreJournalHeader) + count * sizeof(ScoreRecord);
+    sync_range(map, first, first + n * sizeof(ScoreRecord));
+    header->count = count + n;
+    sync_range(map, 0, sizeof(ScoreJournalHeader));
+
+    compact(journal_file, records, header->count);
+    munmap(map, size);
+}
+
+static void write_batch(const ScoreRecord* batch, const int n) {
+    const int fd = open(journal_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return;
+    if (flock(fd, LOCK_EX) == 0) {
+        append_records(fd, batch, n);
+        flock(fd, LOCK_UN);
+    }
+    close(fd);
+}
+
+static void* writer_main(void* unused) {
+    (void) unused;
+    ScoreRecord batch[queue_capacity];
+    pthread_mutex_lock(&lock);
+    while (1) {
+        while (queued == 0 && !stopping)
+            pthread_cond_wait(&wake, &lock);
+        if (queued == 0)
+            break;
+
+        const int n = queued;
+        memcpy(batch, queue, n * sizeof(ScoreRecord));
+        queued = 0;
+        pthread_mutex_unlock(&lock);
+        write_batch(batch, n);
+        pthread_mutex_lock(&lock);
+
+        written += n;
+        pthread_cond_broadcast(&written_cond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int scores_start(void) {
+    const char* path = scores_path();
+    if (path == NULL || running)
+        return 0;
+    snprintf(journal_file, sizeof(journal_file), "%s", path);
+
+    stopping = 0;
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0)
+        return -1;
+    running = 1;
+    return 0;
+}
+
+void scores_submit(const char* game, const int64_t score, const uint32_t duration_ms, const uint64_t seed) {
+    if (!running)
+        return;
+
+    ScoreRecord r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.game, sizeof(r.game), "%s", game);
+    r.score = score;
+    r.duration_ms = duration_ms;
+    r.seed = seed;
+    r.time = time(NULL);
+    r.checksum = record_checksum(&r);
+
+    pthread_mutex_lock(&lock);
+    if (queued < queue_capacity) { // a full queue means the disk is stuck, the game goes on without its score
+        queue[queued++] = r;
+        submitted++;
+        pthread_cond_signal(&wake);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void scores_sync(void) {
+    if (!running)
+        return;
+    pthread_mutex_lock(&lock);
+    while (written < submitted)
+        pthread_cond_wait(&written_cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void scores_stop(void) {
+    if (!running)
+        return;
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    running = 0;
+}
+
+int scores_read_top(const char* game, ScoreRecord* top, const int max) {
+    const char* path = scores_path();
+    if (path == NULL)
+        return 0;
+
+    ScoreIndex index;
+    load_index(path, &index);
+    for (uint32_t i = 0; i < index.num_games; i++) {
+        const ScoreIndexGame* g = &index.games[i];
+        if (strncmp(g->game, game, score_game_size) != 0)
+            continue;
+        const int n = (int) g->count < max ? (int) g->count : max;
+        memcpy(top, g->top, n * sizeof(ScoreRecord));
+        return n;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef VGC_SCORES_H
+#define VGC_SCORES_H
+
+#include <stdint.h>
+
+/*  High scores and play stats, kept next to the bundle. Every finished game appends one fixed-size record to a
+ *  journal that only ever grows:
+ *
+ *      ScoreJournalHeader | ScoreRecord | ScoreRecord | ...     grown and mapped score_chunk records at a time
+ *
+ *  A record is written and synced before the header's count moves past it, and every record checksums itself, so
+ *  a crash at any point leaves either the old count or a record that fails its check and is skipped.
+ *  Games don't touch the file: scores_submit() copies the record into a queue and a background thread appends it,
+ *  under an flock() since a game started from the console writes to the same journal as the console.
+ *  After appending, the same thread merges the new records into the index, the best score_top_n records of every
+ *  game, written to <journal>.top and renamed into place. The menu only ever reads the index, a few KB however long
+ *  the journal has grown.
+ *  The journal is $VGC_SCORES, storage_vgc.scores by default. VGC_SCORES=0 keeps nothing.
+ */
+
+#define SCORE_MAGIC "VGCSCORE"
+#define SCORE_INDEX_MAGIC "VGCSTOP1"
+#define SCORE_VERSION 1
+
+#define score_game_size 24
+#define score_chunk 1024 // records the journal grows by, 64 KB
+#define score_top_n 10
+#define score_max_games 32 // in the index, the ones with the fewest plays go first when there are more
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count; // records that are complete, only moved with the flock held
+    uint8_t reserved[40];
+} ScoreJournalHeader;
+
+typedef struct {
+    char game[score_game_size];
+    int64_t score;
+    uint32_t duration_ms; // ticks played, so time paused or stopped doesn't count
+    uint32_t reserved;
+    uint64_t seed;
+    int64_t time; // unix seconds at the end of the game
+    uint64_t checksum; // of everything before it
+} ScoreRecord;
+
+typedef struct {
+    char game[score_game_size];
+    uint32_t plays; // all records of this game merged so far, not only the kept ones
+    uint32_t count; // of top, best first
+    ScoreRecord top[score_top_n];
+} ScoreIndexGame;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_games;
+    uint64_t covered; // journal records merged into this index
+    uint64_t checksum; // of the games after it
+    ScoreIndexGame games[score_max_games];
+} ScoreIndex;
+
+// where the journal is, NULL if VGC_SCORES=0
+const char* scores_path(void);
+
+// starts the writer thread, start it after the event loop so it has the signals blocked too. Returns -1 on failure
+int scores_start(void);
+// queues a finished game, never waits on the disk. Does nothing if scores_start() wasn't called or failed
+void scores_submit(const char* game, int64_t score, uint32_t duration_ms, uint64_t seed);
+// waits until everything submitted is in the journal and the index
+void scores_sync(void);
+// syncs and stops the writer thread
+void scores_stop(void);
+
+// the best records of game from the index, best first, without reading the journal. Returns how many, 0 if none
+int scores_read_top(const char* game, ScoreRecord* top, int max);
+
+#endif
@@ -0,0 +1,218 @@
+#include "search.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 26 letters, 10 digits, everything else shares the remaining 28 bits
+static uint64_t char_bit(const unsigned char c) {
+    if (c >= 'a' && c <= 'z')
+        return 1ull << (c - 'a');
+    if (c >= '0' && c <= '9')
+        return 1ull << (26 + c - '0');
+    return 1ull << (36 + c % 28);
+}
+
+static uint64_t mask_of(const char* s, const int length) {
+    uint64_t mask = 0;
+    for (int i = 0; i < length; i++)
+        mask |= char_bit(s[i]);
+    return mask;
+}
+
+static const char* key(const GameSearch* search, const int i) {
+    return search->keys + (size_t) i * search_key_size;
+}
+
+GameSearch* create_search(void) {
+    return calloc(1, sizeof(GameSearch));
+}
+
+void free_search(GameSearch* search) {
+    if (search == NULL)
+        return;
+    free(search->keys);
+    free(search->masks);
+    free(search->sorted);
+    free(search->sorted_pos);
+    for (int i = 0; i <= search_max_query; i++)
+        free(search->matches[i]);
+    free(search);
+}
+
+static const GameSearch* sorting; // qsort has no context argument, the index is only ever built from one thread
+
+static int compare_keys(const void* a, const void* b) {
+    const int x = *(const int*) a;
+    const int y = *(const int*) b;
+    const int cmp = strcmp(key(sorting, x), key(sorting, y));
+    return cmp != 0 ? cmp : x - y;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+static int grow(GameSearch* search, const int num_names) {
+    if (num_names <= search->capacity)
+        return 0;
+    int capacity = search->capacity == 0 ? 64 : search->capacity;
+    while (capacity < num_names)
+        capacity *= 2;
+
+    char* keys = realloc(search->keys, (size_t) capacity * search_key_size);
+    if (keys != NULL)
+        search->keys = keys;
+    uint64_t* masks = realloc(search->masks, capacity * sizeof(uint64_t));
+    if (masks != NULL)
+        search->masks = masks;
+    int* sorted = realloc(search->sorted, capacity * sizeof(int));
+    if (sorted != NULL)
+        search->sorted = sorted;
+    int* sorted_pos = realloc(search->sorted_pos, capacity * sizeof(int));
+    if (sorted_pos != NULL)
+        search->sorted_pos = sorted_pos;
+    if (keys == NULL || masks == NULL || sorted == NULL || sorted_pos == NULL)
+        return -1;
+
+    for (int i = 0; i <= search_max_query; i++) {
+        int* matches = realloc(search->matches[i], capacity * sizeof(int));
+        if (matches == NULL)
+            return -1;
+        search->matches[i] = matches;
+    }
+    search->capacity = capacity;
+    return 0;
+}
+
+// the range of sorted whose keys start with query, by binary search
+static void prefix_range(const GameSearch* search, const char* query, const int length, int* from, int* to) {
+    int low = 0, high = search->num_names;
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (strncmp(key(search, search->sorted[mid]), query, length) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    *from = low;
+    high = search->num_names;
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (strncmp(key(search, search->sorted[mid]), query, length) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    *to = low;
+}
+
+static int is_subsequence(const char* query, const char* s) {
+    for (; *query != '\0'; query++) {
+        s = strchr(s, *query);
+        if (s == NULL)
+            return 0;
+        s++;
+    }
+    return 1;
+}
+
+// the matches of the whole query, out of the ones of the query without its last character
+static void match_level(GameSearch* search) {
+    const int level = search->length;
+    const int* before = search->matches[level - 1];
+    const int num_before = search->num_matches[level - 1];
+    int* out = search->matches[level];
+    char query[search_max_query + 1]; // search_reset matches the shorter queries first, with the whole one typed
+    memcpy(query, search->query, level);
+    query[level] = '\0';
+
+    // the names starting with the query matched the shorter one as well, they come straight out of the prefix index
+    int from, to;
+    prefix_range(search, query, level, &from, &to);
+    int n = 0;
+    for (int p = from; p < to; p++)
+        out[n++] = search->sorted[p];
+
+    // then the ones containing it, then the ones with its characters in order. Collected as positions in sorted, so
+    // sorting them puts each group in name order
+    const uint64_t mask = mask_of(query, level);
+    int* rest = out + n; // containing at the front, the others from the back
+    int num_containing = 0;
+    int num_scattered = 0;
+    for (int j = 0; j < num_before; j++) {
+        const int i = before[j];
+        const int pos = search->sorted_pos[i];
+        if ((pos >= from && pos < to) || (search->masks[i] & mask) != mask)
+            continue;
+        if (strstr(key(search, i), query) != NULL)
+            rest[num_containing++] = pos;
+        else if (is_subsequence(query, key(search, i)))
+            out[num_before - 1 - num_scattered++] = pos;
+    }
+    // the scattered ones were written backwards from the end of the space this level can need
+    int* scattered = out + num_before - num_scattered;
+    qsort(rest, num_containing, sizeof(int), compare_ints);
+    qsort(scattered, num_scattered, sizeof(int), compare_ints);
+    memmove(rest + num_containing, scattered, num_scattered * sizeof(int));
+    for (int k = 0; k < num_containing + num_scattered; k++)
+        rest[k] = search->sorted[rest[k]];
+    search->num_matches[level] = n + num_containing + num_scattered;
+}
+
+int search_reset(GameSearch* search, const char* const* names, const int num_names) {
+    if (grow(search, num_names) == -1) {
+        search->num_names = 0;
+        search->length = 0;
+        search->query[0] = '\0';
+        search->num_matches[0] = 0;
+        return -1;
+    }
+    search->num_names = num_names;
+
+    for (int i = 0; i < num_names; i++) {
+        char* k = search->keys + (size_t) i * search_key_size;
+        const char* name = names[i];
+        if (strncmp(name, "game_", 5) == 0)
+            name += 5;
+        int length = 0;
+        for (; name[length] != '\0' && length < search_key_size - 1; length++)
+            k[length] = (char) tolower((unsigned char) name[length]);
+        k[length] = '\0';
+        search->masks[i] = mask_of(k, length);
+        search->sorted[i] = i;
+        search->matches[0][i] = i;
+    }
+    search->num_matches[0] = num_names;
+
+    sorting = search;
+    qsort(search->sorted, num_names, sizeof(int), compare_keys);
+    for (int p = 0; p < num_names; p++)
+        search->sorted_pos[search->sorted[p]] = p;
+
+    // the query stays, matched again level by level against the new names
+    const int length = search->length;
+    for (search->length = 1; search->length <= length; search->length++)
+        match_level(search);
+    search->length = length;
+    return 0;
+}
+
+int search_push(GameSearch* search, const char c) {
+    if (search->length == search_max_query)
+        return -1;
+    search->query[search->length++] = (char) tolower((unsigned char) c);
+    search->query[search->length] = '\0';
+    match_level(search);
+    return 0;
+}
+
+void search_pop(GameSearch* search) {
+    if (search->length > 0)
+        search->query[--search->length] = '\0';
+}
+
+void search_clear(GameSearch* search) {
+    search->length = 0;
+    search->query[0] = '\0';
+}
@@ -0,0 +1,50 @@
+#ifndef VGC_SEARCH_H
+#define VGC_SEARCH_H
+
+#include <stdint.h>
+
+/*  Incremental fuzzy search over the menu's list of games, made for thousands of names.
+ *  A name matches when the query's characters appear in it in order, ignoring case and the game_ every name starts
+ *  with. The names starting with the query come first, then the ones containing it, then the rest, each in name order.
+ *  search_reset() builds the index once per list: the keys sorted, so the names starting with the query are one
+ *  binary search away, and a mask per name of the characters in it, which turns most names down in one AND.
+ *  A longer query never matches more, so a typed character only looks at the names that matched before it. The
+ *  matches of every query length are kept, and backspace goes back to the ones before without looking at any name.
+ */
+
+#define search_max_query 32
+#define search_key_size 80 // a catalog name with "resume " in front still fits
+
+typedef struct {
+    int num_names;
+    int capacity;
+    char* keys;        // num_names of search_key_size, lowercase and without game_
+    uint64_t* masks;   // per name, one bit per character class in its key
+    int* sorted;       // name indices in key order, the prefix index
+    int* sorted_pos;   // where every name is in sorted
+
+    char query[search_max_query + 1];
+    int length;
+    int* matches[search_max_query + 1]; // of the query's first n characters, matches[0] is every name as given
+    int num_matches[search_max_query + 1];
+} GameSearch;
+
+GameSearch* create_search(void);
+void free_search(GameSearch* search);
+
+// indexes a new list of names and matches the query typed so far against it. Returns -1 if out of memory
+int search_reset(GameSearch* search, const char* const* names, int num_names);
+
+// adds a character to the query, returns -1 if the query is full
+int search_push(GameSearch* search, char c);
+// takes the last character off the query
+void search_pop(GameSearch* search);
+void search_clear(GameSearch* search);
+
+// the names matching the whole query, best first, as indices into the names given to search_reset
+static inline const int* search_results(const GameSearch* search, int* count) {
+    *count = search->num_matches[search->length];
+    return search->matches[search->length];
+}
+
+#endif
@@ -0,0 +1,241 @@
+#include "snake_core.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define initial_snake_capacity 16
+#define bait_tries 16 // random cells tried for a bait before counting rows, enough unless the board is nearly full
+#define empty_word_cells 32 // cells in a uint64_t of b->cells
+
+const char cell_chars[4] = {char_empty, char_head, char_tail, char_bait};
+
+// chebyshev distance, 1 means the cells touch
+static int distance(const Board* b, const int p, const int q) {
+    const int dx = abs(p % b->width - q % b->width);
+    const int dy = abs(p / b->width - q / b->width);
+    return dx > dy ? dx : dy;
+}
+
+// from the arena if there is one, it frees everything at once
+static void* board_alloc(Arena* arena, const size_t size) {
+    return arena != NULL ? arena_alloc(arena, size) : malloc(size);
+}
+
+// the Fenwick tree: row_free[i - 1] counts the empty cells of the i & -i rows ending with row i - 1
+static void row_free_add(Board* b, const int y, const int delta) {
+    for (int i = y + 1; i <= b->height; i += i & -i)
+        b->row_free[i - 1] += delta;
+}
+
+static void set_cell(Board* b, const int pos, const int cell) {
+    const int old = board_cell(b, pos);
+    const int shift = (pos & 3) * 2;
+    b->cells[pos >> 2] = (uint8_t) ((b->cells[pos >> 2] & ~(3 << shift)) | cell << shift);
+
+    const int freed = (cell == cell_empty) - (old == cell_empty);
+    b->num_free += freed;
+    if (freed != 0)
+        row_free_add(b, pos / b->width, freed);
+    if (cell == cell_bait)
+        b->bait_pos = pos;
+    b->changes[b->num_changes++] = (CellChange) {pos % b->width, pos / b->width, cell_chars[cell]};
+}
+
+// the nth empty cell in board order, n < b->num_free
+static int nth_free_cell(const Board* b, int n) {
+    // down the tree to the row, skipping whole blocks of rows with n or fewer empty cells in them
+    int step = 1;
+    while (step * 2 <= b->height)
+        step *= 2;
+    int y = 0;
+    for (; step > 0; step /= 2) {
+        if (y + step <= b->height && b->row_free[y + step - 1] <= n) {
+            y += step;
+            n -= b->row_free[y - 1];
+        }
+    }
+
+    // then along the row, a word of 32 cells at a time: a cell is empty when both its bits are 0
+    int pos = y * b->width;
+    const int end = pos + b->width;
+    for (; pos % empty_word_cells != 0 && pos < end; pos++) {
+        if (board_cell(b, pos) == cell_empty && n-- == 0)
+            return pos;
+    }
+    for (; pos + empty_word_cells <= end; pos += empty_word_cells) {
+        uint64_t word;
+        memcpy(&word, b->cells + pos / 4, sizeof(word));
+        const int empty = empty_word_cells - __builtin_popcountll((word | word >> 1) & 0x5555555555555555ull);
+        if (n < empty)
+            break;
+        n -= empty;
+    }
+    for (;; pos++) {
+        if (board_cell(b, pos) == cell_empty && n-- == 0)
+            return pos;
+    }
+}
+
+// uniform over the empty cells, which is what a random cell that happens to be empty is too
+static int random_free_cell(Board* b) {
+    for (int i = 0; i < bait_tries; i++) {
+        const int pos = (int) rng_below(&b->rng, b->width * b->height);
+        if (board_cell(b, pos) == cell_empty)
+            return pos;
+    }
+    return nth_free_cell(b, (int) rng_below(&b->rng, b->num_free));
+}
+
+Board* create_initial_board(const int width, const int height, const unsigned long seed) {
+    return create_board_in(NULL, width, height, seed);
+}
+
+Board* create_board_in(Arena* arena, const int width, const int height, const unsigned long seed) {
+    if (width < 3 || width > board_max_side || height < 1 || height > board_max_side)
+        return NULL;
+
+    Board* board = board_alloc(arena, sizeof(Board));
+    if (board == NULL)
+        return NULL;
+
+    rng_seed(&board->rng, seed);
+    board->arena = arena;
+    board->width = width;
+    board->height = height;
+
+    const size_t cells_size = ((size_t) width * height + 3) / 4;
+    board->cells = board_alloc(arena, cells_size);
+    board->snake = board_alloc(arena, sizeof(int) * initial_snake_capacity);
+    board->row_free = board_alloc(arena, sizeof(int) * height);
+    if (board->cells == NULL || board->snake == NULL || board->row_free == NULL) {
+        free_board(board);
+        return NULL;
+    }
+    board->snake_capacity = initial_snake_capacity;
+    board->snake_length = 2;
+    board->snake_head_idx = 1;
+    board->num_changes = 0;
+
+    // initial field of empty cells, cell_empty is 0
+    memset(board->cells, 0, cells_size);
+    board->num_free = width * height;
+    for (int i = 1; i <= height; i++)
+        board->row_free[i - 1] = width * (i & -i);
+
+    // put snake in the middle
+    int snake_pos = board_index(board, width / 2, height / 2);
+
+    set_cell(board, snake_pos, cell_head);
+    board->snake[board->snake_head_idx] = snake_pos;
+
+    // decide tail position, currently always placed on the left
+    int tail_pos = snake_pos - 1;
+    set_cell(board, tail_pos, cell_tail);
+    board->snake[board->snake_head_idx - 1] = tail_pos;
+
+    // decide initial direction, currently always going to the right
+    board->snake_direction = snake_right;
+
+    // put bait on a random empty cell that doesn't touch the snake, walking on from a random one so it always ends,
+    // even on a board too small to have such a cell
+    const int size = width * height;
+    const int start = random_free_cell(board);
+    int bait_pos = start;
+    for (int i = 0; i < size; i++) {
+        const int candidate = (start + i) % size;
+        if (board_cell(board, candidate) == cell_empty && distance(board, candidate, snake_pos) >= 2 && distance(board, candidate, tail_pos) >= 2) {
+            bait_pos = candidate;
+            break;
+        }
+    }
+    set_cell(board, bait_pos, cell_bait);
+
+    board->num_changes = 0; // the first render draws everything anyway
+    return board;
+}
+
+void free_board(Board* b) {
+    if (b != NULL && b->arena == NULL) {
+        free(b->cells);
+        free(b->snake);
+        free(b->row_free);
+        free(b);
+    }
+}
+
+// doubles the snake ring, the oldest position ends up at 0. Returns 0 if it couldn't be allocated
+static int grow_snake(Board* b) {
+    const int capacity = b->snake_capacity * 2;
+    int* ring = board_alloc(b->arena, sizeof(int) * capacity);
+    if (ring == NULL)
+        return 0;
+
+    const int oldest = b->snake_head_idx - b->snake_length;
+    for (int i = 0; i <= b->snake_length; i++)
+        ring[i] = b->snake[(oldest + i) & (b->snake_capacity - 1)];
+    if (b->arena == NULL)
+        free(b->snake);
+    b->snake = ring;
+    b->snake_capacity = capacity;
+    b->snake_head_idx = b->snake_length;
+    return 1;
+}
+
+int snake_step(Board* b, const int direction) {
+    b->num_changes = 0;
+
+    // if direction will be changed and new direction isn't opposite
+    if (direction != -1 && (direction - b->snake_direction + 4) % 4 != 2) {
+        b->snake_direction = direction;
+    }
+
+    const int next_x = (b->snake[b->snake_head_idx] % b->width) + (b->snake_direction == snake_right) - (b->snake_direction == snake_left);
+    const int next_y = (b->snake[b->snake_head_idx] / b->width) + (b->snake_direction == snake_down) - (b->snake_direction == snake_up);
+
+    // collision checks, we don't end the game in collision, just wait for new input
+    if (next_x < 0 || next_x >= b->width || next_y < 0 || next_y >= b->height) // out of bounds
+        return SNAKE_BLOCKED;
+    const int next_head_pos = board_index(b, next_x, next_y);
+    if (board_cell(b, next_head_pos) == cell_tail) // collision with tail
+        return SNAKE_BLOCKED;
+
+    // the ring keeps the snake and the cell its tail leaves this step
+    if (b->snake_length + 1 > b->snake_capacity && !grow_snake(b))
+        return SNAKE_BLOCKED;
+
+    const int bait_eaten = board_cell(b, next_head_pos) == cell_bait;
+
+    const int prev_head_pos = b->snake[b->snake_head_idx];
+    set_cell(b, prev_head_pos, cell_tail); // previous head becomes tail
+
+    b->snake_head_idx = (b->snake_head_idx + 1) & (b->snake_capacity - 1); // update the index of head in snake array
+    b->snake[b->snake_head_idx] = next_head_pos; // update the new head position
+    set_cell(b, next_head_pos, cell_head);
+
+    // if a bait is eaten, just increase the snake length and spawn a new bait
+    if (bait_eaten) {
+        b->snake_length++;
+        if (b->num_free == 0)
+            return SNAKE_MOVED | SNAKE_BAIT_EATEN | SNAKE_WON; // there is nowhere to put it
+        set_cell(b, random_free_cell(b), cell_bait);
+        return SNAKE_MOVED | SNAKE_BAIT_EATEN;
+    }
+
+    // if not, remove the last cell of tail
+    const int tail_end_index = (b->snake_head_idx - b->snake_length) & (b->snake_capacity - 1);
+    set_cell(b, b->snake[tail_end_index], cell_empty);
+    return SNAKE_MOVED;
+}
+
+uint64_t snake_hash(const Board* b) {
+    uint64_t hash = hash_int(hash_init, b->width);
+    hash = hash_int(hash, b->height);
+    hash = hash_bytes(hash, b->cells, ((size_t) b->width * b->height + 3) / 4);
+    // the body from the head back, the ring offset itself doesn't matter
+    for (int i = 0; i < b->snake_length; i++)
+        hash = hash_int(hash, b->snake[(b->snake_head_idx - i) & (b->snake_capacity - 1)]);
+    hash = hash_int(hash, b->snake_length);
+    hash = hash_int(hash, b->snake_direction);
+    return hash_int(hash, (long long) b->rng.state);
+}
@@ -0,0 +1,97 @@
+#ifndef VGC_SNAKE_CORE_H
+#define VGC_SNAKE_CORE_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "cell_change.h"
+#include "rng.h"
+
+/*  Snake rules without any terminal code. snake_step() advances the board by one tick and
+ *  lists the cells it changed in board->changes, the front end decides how to draw them.
+ *  The board size is picked at runtime, up to board_max_side on each side. A cell is 2 bits, so a 4096 x 4096 board
+ *  is 4 MiB, and nothing else is kept per cell: the snake ring grows with the snake, and a new bait is found by
+ *  trying random cells, then through a Fenwick tree of the free cells per row and a popcount over the row's words,
+ *  O(log height + width / 32) on a nearly full board.
+ */
+
+#define default_board_width 20
+#define default_board_height 25
+#define board_max_side 4096
+
+// what a cell holds, 2 bits
+#define cell_empty 0
+#define cell_head 1
+#define cell_tail 2
+#define cell_bait 3
+
+#define char_head 'O'
+#define char_tail '#'
+#define char_bait 'X'
+#define char_empty '.'
+
+extern const char cell_chars[4]; // the char_ above, by cell
+
+// directions, -1 keeps the current one
+#define snake_up 0
+#define snake_right 1
+#define snake_down 2
+#define snake_left 3
+
+// events returned by snake_step
+#define SNAKE_MOVED      1
+#define SNAKE_BLOCKED    2 // wall or tail ahead, we don't end the game in collision, the snake just waits for new input
+#define SNAKE_BAIT_EATEN 4
+#define SNAKE_WON        8 // the snake fills the board, there is no cell left for a new bait
+
+#define max_snake_changes 4
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t* cells; // 4 cells per byte, cell i in bits 2 * (i % 4) of byte i / 4
+
+    /*  circular array of the past positions of the snake head. To get the full position of the snake, start from the
+     *  head and trace back the array snake_length times. It holds one more than the snake, the cell the tail just
+     *  left, and doubles when the snake outgrows it
+     */
+    int* snake;
+    int snake_capacity; // a power of 2
+    int snake_head_idx;
+    int snake_length;
+    int snake_direction; // 0: up, 1: right, 2: down, 3: left
+
+    int bait_pos;
+    int num_free;  // empty cells
+    int* row_free; // Fenwick tree of the empty cells per row, to find the nth empty cell without a list of them
+
+    Rng rng;
+
+    CellChange changes[max_snake_changes]; // cells changed by the last snake_step
+    int num_changes;
+
+    Arena* arena; // allocated with create_board_in, the arena owns the memory
+} Board;
+
+/* top left corner: (0, 0)
+* bottom right corner: (b->width-1, b->height-1) */
+static inline int board_index(const Board* b, const int x, const int y) {
+    return x + y * b->width;
+}
+
+static inline int board_cell(const Board* b, const int pos) {
+    return b->cells[pos >> 2] >> ((pos & 3) * 2) & 3;
+}
+
+// NULL if the size is out of range or it couldn't be allocated
+Board* create_initial_board(int width, int height, unsigned long seed);
+// the board and its arrays in the arena, free_board leaves them alone and arena_reset reclaims them
+Board* create_board_in(Arena* arena, int width, int height, unsigned long seed);
+void free_board(Board* b);
+
+int snake_step(Board* b, int direction);
+
+// hash of everything the next steps depend on, two boards with the same hash play on the same
+uint64_t snake_hash(const Board* b);
+
+#endif
@@ -0,0 +1,266 @@
+#include "spectate.h"
+#include "clock.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static SpectateSlot* slot_at(const SpectateHeader* h, const uint64_t frame) {
+    return (SpectateSlot*) ((char*) h + sizeof(SpectateHeader) + (size_t) (frame % h->num_slots) * h->slot_size);
+}
+
+static size_t data_capacity(const int cells) {
+    // a frame with more than cells / 4 changes goes out as a keyframe instead
+    const size_t delta = (size_t) (cells / 4) * sizeof(SpectateCell);
+    return delta > (size_t) cells ? delta : (size_t) cells;
+}
+
+Spectate* spectate_start(const char* name, const int cols, const int rows) {
+    Spectate* s = malloc(sizeof(Spectate));
+    if (s == NULL)
+        return NULL;
+    snprintf(s->shm_name, sizeof(s->shm_name), "/" SPECTATE_PREFIX "%d", (int) getpid());
+
+    const uint32_t slot_size = (sizeof(SpectateSlot) + data_capacity(cols * rows) + 63) & ~63u;
+    s->size = sizeof(SpectateHeader) + (size_t) slot_size * spectate_slots;
+    s->frames_since_keyframe = 0;
+
+    const int fd = shm_open(s->shm_name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        free(s);
+        return NULL;
+    }
+    // ftruncate zeroes it, so every slot starts at seq 0, never written
+    if (ftruncate(fd, s->size) == -1
+        || (s->header = mmap(NULL, s->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        shm_unlink(s->shm_name);
+        free(s);
+        return NULL;
+    }
+    close(fd);
+
+    SpectateHeader* h = s->header;
+    memcpy(h->magic, SPECTATE_MAGIC, sizeof(h->magic));
+    h->version = SPECTATE_VERSION;
+    h->pid = getpid();
+    snprintf(h->name, sizeof(h->name), "%s", name);
+    h->created_ns = monotonic_ns();
+    h->cols = cols;
+    h->rows = rows;
+    h->slot_size = slot_size;
+    h->num_slots = spectate_slots;
+    return s;
+}
+
+void spectate_publish(Spectate* s, const char* screen, const int cols, const int rows, const int* changed,
+                      const int num_changed) {
+    SpectateHeader* h = s->header;
+    const uint64_t frame = atomic_load_explicit(&h->head, memory_order_relaxed); // we are the only writer
+    SpectateSlot* slot = slot_at(h, frame);
+    char* data = (char*) slot + sizeof(SpectateSlot);
+    const int cells = h->cols * h->rows;
+    const int keyframe = frame == 0 || s->frames_since_keyframe + 1 >= spectate_keyframe_interval
+                         || num_changed > cells / 4;
+
+    atomic_store_explicit(&slot->seq, 2 * frame + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // readers see the odd seq before any of the new data
+
+    if (keyframe) {
+        for (int y = 0; y < (int) h->rows; y++) {
+            for (int x = 0; x < (int) h->cols; x++)
+                data[y * h->cols + x] = x < cols && y < rows ? screen[y * cols + x] : ' ';
+        }
+        slot->type = SPECTATE_KEYFRAME;
+        slot->count = 0;
+        s->frames_since_keyframe = 0;
+    }
+    else {
+        SpectateCell* out = (SpectateCell*) data;
+        int count = 0;
+        for (int i = 0; i < num_changed; i++) {
+            const int x = changed[i] % cols;
+            const int y = changed[i] / cols;
+            if (x < (int) h->cols && y < (int) h->rows)
+                out[count++] = (SpectateCell) {x, y, screen[changed[i]]};
+        }
+        slot->type = SPECTATE_DELTA;
+        slot->count = count;
+        s->frames_since_keyframe++;
+    }
+
+    atomic_store_explicit(&slot->seq, 2 * frame + 2, memory_order_release);
+    if (keyframe)
+        atomic_store_explicit(&h->next_keyframe, frame + 1, memory_order_release);
+    atomic_store_explicit(&h->head, frame + 1, memory_order_release);
+}
+
+void spectate_stop(Spectate* s) {
+    if (s == NULL)
+        return;
+    atomic_store_explicit(&s->header->closed, 1, memory_order_release);
+    munmap(s->header, s->size);
+    shm_unlink(s->shm_name);
+    free(s);
+}
+
+SpectateView* spectate_attach(const pid_t pid) {
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/" SPECTATE_PREFIX "%d", (int) pid);
+    const int fd = shm_open(shm_name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1)
+        return NULL;
+
+    SpectateHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || memcmp(header.magic, SPECTATE_MAGIC, sizeof(header.magic)) != 0 || header.version != SPECTATE_VERSION) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    SpectateView* v = malloc(sizeof(SpectateView));
+    if (v == NULL) {
+        close(fd);
+        return NULL;
+    }
+    v->size = sizeof(SpectateHeader) + (size_t) header.slot_size * header.num_slots;
+    v->header = mmap(NULL, v->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (v->header == MAP_FAILED) {
+        free(v);
+        return NULL;
+    }
+    v->scratch = malloc(header.slot_size);
+    if (v->scratch == NULL) {
+        munmap((void*) v->header, v->size);
+        free(v);
+        errno = ENOMEM;
+        return NULL;
+    }
+    v->frames = 0;
+    v->jumps = 0;
+
+    // start from the newest keyframe, everything before it is covered by it
+    const uint64_t next_keyframe = atomic_load_explicit(&v->header->next_keyframe, memory_order_acquire);
+    v->next = next_keyframe > 0 ? next_keyframe - 1 : 0;
+    return v;
+}
+
+void spectate_detach(SpectateView* v) {
+    if (v != NULL) {
+        munmap((void*) v->header, v->size);
+        free(v->scratch);
+        free(v);
+    }
+}
+
+// returns 0 if there is no keyframe to jump to yet
+static int jump_to_keyframe(SpectateView* v) {
+    const uint64_t next_keyframe = atomic_load_explicit(&v->header->next_keyframe, memory_order_acquire);
+    if (next_keyframe == 0)
+        return 0;
+    v->next = next_keyframe - 1;
+    v->jumps++;
+    return 1;
+}
+
+static void apply_frame(const SpectateView* v, const SpectateSlot* frame, char* grid) {
+    const char* data = (const char*) frame + sizeof(SpectateSlot);
+    const int cells = v->header->cols * v->header->rows;
+    if (frame->type == SPECTATE_KEYFRAME) {
+        memcpy(grid, data, cells);
+        return;
+    }
+    const SpectateCell* changes = (const SpectateCell*) data;
+    for (uint32_t i = 0; i < frame->count; i++) {
+        if (changes[i].x < v->header->cols && changes[i].y < v->header->rows)
+            grid[changes[i].y * v->header->cols + changes[i].x] = changes[i].c;
+    }
+}
+
+int spectate_read(SpectateView* v, char* grid) {
+    const SpectateHeader* h = v->header;
+    const size_t max_count = (h->slot_size - sizeof(SpectateSlot)) / sizeof(SpectateCell);
+    int applied = 0;
+
+    for (;;) {
+        const uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+        if (v->next >= head)
+            return applied;
+        // the producer is about to lap us, the slot we want may already be half rewritten
+        if (head - v->next >= h->num_slots - 1) {
+            if (!jump_to_keyframe(v))
+                return applied;
+            continue;
+        }
+
+        const SpectateSlot* slot = slot_at(h, v->next);
+        const uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != 2 * v->next + 2) { // rewritten for a newer frame since we read head
+            if (!jump_to_keyframe(v))
+                return applied;
+            continue;
+        }
+
+        // copy out first, a torn copy must never reach the grid
+        SpectateSlot* copy = (SpectateSlot*) v->scratch;
+        memcpy(copy, slot, h->slot_size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq || copy->count > max_count) {
+            if (!jump_to_keyframe(v))
+                return applied;
+            continue;
+        }
+
+        apply_frame(v, copy, grid);
+        v->next++;
+        v->frames++;
+        applied++;
+    }
+}
+
+uint64_t spectate_lag(const SpectateView* v) {
+    const uint64_t head = atomic_load_explicit(&v->header->head, memory_order_acquire);
+    return head > v->next ? head - v->next : 0;
+}
+
+pid_t spectate_find_newest(void) {
+    DIR* dir = opendir("/dev/shm");
+    if (dir == NULL)
+        return 0;
+
+    pid_t newest = 0;
+    long long newest_ns = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, SPECTATE_PREFIX, strlen(SPECTATE_PREFIX)) != 0)
+            continue;
+        const pid_t pid = atoi(entry->d_name + strlen(SPECTATE_PREFIX));
+        // a producer that crashed leaves its ring behind
+        if (pid <= 0 || pid == getpid() || (kill(pid, 0) == -1 && errno == ESRCH))
+            continue;
+
+        char path[300];
+        snprintf(path, sizeof(path), "/dev/shm/%s", entry->d_name);
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+        SpectateHeader header;
+        const ssize_t n = pread(fd, &header, sizeof(header), 0);
+        close(fd);
+        if (n == sizeof(header) && memcmp(header.magic, SPECTATE_MAGIC, sizeof(header.magic)) == 0
+            && !header.closed && header.created_ns > newest_ns) {
+            newest = pid;
+            newest_ns = header.created_ns;
+        }
+    }
+    closedir(dir);
+    return newest;
+}
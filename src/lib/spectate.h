@@ -0,0 +1,92 @@
+#ifndef VGC_SPECTATE_H
+#define VGC_SPECTATE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*  Spectator mode. With VGC_SPECTATE set in the environment, every renderer that draws to a terminal also publishes
+ *  its frames to a ring in POSIX shared memory, /dev/shm/vgc-spectate-<pid>, and vgc-watch maps that ring read-only
+ *  and draws it in another terminal.
+ *  A frame is the list of cells a flush changed, or every cell for a keyframe, which goes out every
+ *  spectate_keyframe_interval frames and whenever a frame changes more than a quarter of the screen. Each slot has a
+ *  seqlock sequence number, so the producer writes without ever looking at its readers: publishing costs the same
+ *  with zero or ten spectators, and it happens in renderer_flush, after the terminal got its frame.
+ *  A reader that was lapped, or caught a slot being rewritten under it, jumps to the newest keyframe.
+ */
+
+#define SPECTATE_MAGIC "VGCSPECT"
+#define SPECTATE_VERSION 1
+#define SPECTATE_PREFIX "vgc-spectate-" // + pid, under /dev/shm
+
+#define spectate_slots 64
+#define spectate_keyframe_interval 32 // frames, less than spectate_slots so the newest keyframe is always in the ring
+
+#define SPECTATE_KEYFRAME 1 // cols * rows chars
+#define SPECTATE_DELTA    2 // count SpectateCells
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    char name[32];
+    long long created_ns; // CLOCK_MONOTONIC, vgc-watch follows the newest ring
+    uint32_t cols; // of the grid, fixed for the life of the ring, a bigger screen is clipped
+    uint32_t rows;
+    uint32_t slot_size;
+    uint32_t num_slots;
+    _Atomic uint64_t head;          // frames published so far, frame n is in slot n % num_slots
+    _Atomic uint64_t next_keyframe; // the frame after the newest keyframe, 0 until the first one
+    _Atomic uint32_t closed;        // the producer is done, nothing else is coming
+} SpectateHeader;
+
+typedef struct {
+    _Atomic uint64_t seq; // 2n + 1 while frame n is being written, 2n + 2 once it is complete
+    uint32_t type;
+    uint32_t count;
+} SpectateSlot; // followed by the frame's data, slot_size bytes in total
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    char c;
+} SpectateCell;
+
+// the producer side, owned by a Renderer
+typedef struct {
+    SpectateHeader* header;
+    size_t size;
+    char shm_name[64];
+    uint64_t frames_since_keyframe;
+} Spectate;
+
+// creates the ring for this process, NULL if shared memory isn't available
+Spectate* spectate_start(const char* name, int cols, int rows);
+// cell i of the screen is screen[i], changed lists the indices of the cells this frame changed
+void spectate_publish(Spectate* s, const char* screen, int cols, int rows, const int* changed, int num_changed);
+// marks the ring closed and removes its name, mapped readers keep what they have
+void spectate_stop(Spectate* s);
+
+// the reader side, vgc-watch
+typedef struct {
+    const SpectateHeader* header;
+    size_t size;
+    uint64_t next;  // frame to read next
+    char* scratch;  // one slot, frames are copied out of the ring before they are applied
+    long frames;    // applied
+    long jumps;     // times we fell behind and skipped to a keyframe
+} SpectateView;
+
+// maps the ring of the given process, NULL with errno set if there is none
+SpectateView* spectate_attach(pid_t pid);
+void spectate_detach(SpectateView* v);
+// applies every frame published since the last call to grid (header->cols * header->rows chars),
+// returns the number of frames applied
+int spectate_read(SpectateView* v, char* grid);
+// frames published that the view hasn't read yet
+uint64_t spectate_lag(const SpectateView* v);
+
+// the pid of the newest live ring, 0 if there is none
+pid_t spectate_find_newest(void);
+
+#endif
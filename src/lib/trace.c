@@ -0,0 +1,134 @@
+#include "trace.h"
+#include "clock.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ring_capacity (1 << 16) // 1 MB of records, about a minute of a busy game between two writer passes
+#define writer_period_ms 50
+
+int trace_enabled = 0;
+
+static TraceRecord ring[ring_capacity];
+static atomic_ulong ring_head; // next slot the game thread writes, only the game thread moves it
+static atomic_ulong ring_tail; // next slot the writer thread reads, only the writer thread moves it
+static atomic_ulong dropped;
+
+static int trace_fd = -1;
+static char trace_file[256];
+static pthread_t writer;
+static atomic_int stopping;
+
+void trace_record(const uint16_t type, const uint32_t arg) {
+    const unsigned long head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    const unsigned long tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head - tail == ring_capacity) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    TraceRecord* r = &ring[head % ring_capacity];
+    r->ts_ns = monotonic_ns();
+    r->type = type;
+    r->reserved = 0;
+    r->arg = arg;
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release); // publishes the record to the writer
+}
+
+static void write_all(const void* data, size_t size) {
+    const char* p = data;
+    while (size > 0) {
+        const ssize_t n = write(trace_fd, p, size);
+        if (n <= 0)
+            return;
+        p += n;
+        size -= n;
+    }
+}
+
+static void drain_ring(void) {
+    const unsigned long head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    unsigned long tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+
+    while (tail != head) {
+        // up to the end of the ring in one write, the rest in the next round
+        const unsigned long start = tail % ring_capacity;
+        unsigned long count = head - tail;
+        if (start + count > ring_capacity)
+            count = ring_capacity - start;
+
+        write_all(&ring[start], count * sizeof(TraceRecord));
+        tail += count;
+        atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    }
+
+    const unsigned long lost = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+    if (lost > 0) {
+        const TraceRecord r = {(uint64_t) monotonic_ns(), TRACE_DROPPED, 0, (uint32_t) lost};
+        write_all(&r, sizeof(r));
+    }
+}
+
+static void* writer_main(void* unused) {
+    (void) unused;
+    const struct timespec period = {0, writer_period_ms * 1000000l};
+    while (!atomic_load(&stopping)) {
+        nanosleep(&period, NULL);
+        drain_ring();
+    }
+    drain_ring();
+    return NULL;
+}
+
+int trace_start(const char* path, const char* name) {
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd == -1) {
+        perror("could not open trace file");
+        return -1;
+    }
+    snprintf(trace_file, sizeof(trace_file), "%s", path);
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.pid = getpid();
+    snprintf(header.name, sizeof(header.name), "%s", name);
+    write_all(&header, sizeof(header));
+
+    atomic_store(&stopping, 0);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        close(trace_fd);
+        trace_fd = -1;
+        return -1;
+    }
+    trace_enabled = 1;
+    return 0;
+}
+
+int trace_start_from_args(const int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--trace") == 0)
+            return trace_start(argv[i + 1], name);
+    }
+    return 0;
+}
+
+const char* trace_path(void) {
+    return trace_enabled ? trace_file : NULL;
+}
+
+void trace_stop(void) {
+    if (!trace_enabled)
+        return;
+
+    trace_enabled = 0;
+    atomic_store(&stopping, 1);
+    pthread_join(writer, NULL);
+    close(trace_fd);
+    trace_fd = -1;
+}
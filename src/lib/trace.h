@@ -0,0 +1,58 @@
+#ifndef VGC_TRACE_H
+#define VGC_TRACE_H
+
+#include <stdint.h>
+
+/*  --trace <file> support. trace_event() stores a 16 byte record in an in-memory ring buffer, a background thread
+ *  writes the ring to the file, so the game thread never does file I/O. When the ring is full records are dropped
+ *  and counted instead of waiting. src/tools/vgc-trace2json.c turns the file into Chrome/Perfetto trace JSON.
+ */
+
+#define TRACE_MAGIC "VGCTRACE"
+#define TRACE_VERSION 1
+
+// record types
+#define TRACE_INPUT        1 // arg: the key
+#define TRACE_TICK_BEGIN   2 // arg: tick number
+#define TRACE_TICK_END     3
+#define TRACE_RENDER_BEGIN 4
+#define TRACE_RENDER_END   5 // arg: bytes written to the terminal
+#define TRACE_LAUNCH_BEGIN 6 // console starts a game
+#define TRACE_LAUNCH_END   7 // arg: exit status
+#define TRACE_DROPPED      8 // arg: records lost because the ring was full, written by the writer thread
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    char name[32];
+} TraceHeader;
+
+typedef struct {
+    uint64_t ts_ns; // CLOCK_MONOTONIC
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t arg;
+} TraceRecord;
+
+extern int trace_enabled;
+
+// opens the file given with --trace in argv, if there is one, and starts the writer thread. Returns -1 on failure
+int trace_start_from_args(int argc, char** argv, const char* name);
+int trace_start(const char* path, const char* name);
+
+// the file --trace pointed to, NULL when not tracing
+const char* trace_path(void);
+
+void trace_record(uint16_t type, uint32_t arg);
+
+// cheap enough to leave in the hot path, one predictable branch when tracing is off
+static inline void trace_event(const uint16_t type, const uint32_t arg) {
+    if (trace_enabled)
+        trace_record(type, arg);
+}
+
+// writes what is left in the ring and closes the file
+void trace_stop(void);
+
+#endif
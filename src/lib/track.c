@@ -0,0 +1,237 @@
+#include "track.h"
+#include "hash.h"
+#include "rng.h"
+
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static void* track_alloc(Arena* arena, const size_t size) {
+    return arena != NULL ? arena_alloc(arena, size) : malloc(size);
+}
+
+static void futex_wait(atomic_uint* word, const unsigned int value) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// ---- generator ----
+
+static int count_bits(const uint64_t* row, const int words) {
+    int count = 0;
+    for (int w = 0; w < words; w++)
+        count += __builtin_popcountll(row[w]);
+    return count;
+}
+
+// the lanes one step left or right of a lane in from, or in it, across word boundaries and within the width
+static void spread(const TrackGenerator* g, const uint64_t* from, uint64_t* to) {
+    for (int w = 0; w < g->words_per_row; w++) {
+        const uint64_t carry_in = w > 0 ? from[w - 1] >> 63 : 0;
+        const uint64_t carry_out = w + 1 < g->words_per_row ? from[w + 1] << 63 : 0;
+        to[w] = from[w] | from[w] << 1 | carry_in | from[w] >> 1 | carry_out;
+    }
+    if (g->width % 64 != 0)
+        to[g->words_per_row - 1] &= (1ull << (g->width % 64)) - 1;
+}
+
+static double chunk_density(const long chunk) {
+    const double ramp = chunk < track_ramp_chunks ? (double) chunk / track_ramp_chunks : 1.0;
+    return track_start_density + (track_full_density - track_start_density) * ramp;
+}
+
+// one of the lanes in mask at random, as a word index and the lane's bit in it. mask can't be empty
+static int pick_lane(Rng* rng, const uint64_t* mask, const int words, uint64_t* lane) {
+    int pick = (int) rng_below(rng, count_bits(mask, words));
+    for (int w = 0; w < words; w++) {
+        const int here = __builtin_popcountll(mask[w]);
+        if (pick >= here) {
+            pick -= here;
+            continue;
+        }
+        uint64_t bits = mask[w];
+        while (pick-- > 0)
+            bits &= bits - 1;
+        *lane = bits & -bits;
+        return w;
+    }
+    return -1;
+}
+
+// the lanes of g->reachable that row leaves without a move: all of lane-1, lane and lane+1 are taken on last_row or row
+static int stuck_lanes(const TrackGenerator* g, const uint64_t* row, uint64_t* open_lanes, uint64_t* stuck) {
+    const int words = g->words_per_row;
+    for (int w = 0; w < words; w++)
+        open_lanes[w] = ~g->last_row[w] & ~row[w];
+    if (g->width % 64 != 0)
+        open_lanes[words - 1] &= (1ull << (g->width % 64)) - 1; // past the edge isn't a lane
+    spread(g, open_lanes, stuck); // the lanes with a free lane next to them or in front
+    int any = 0;
+    for (int w = 0; w < words; w++) {
+        stuck[w] = g->reachable[w] & ~stuck[w];
+        any |= stuck[w] != 0;
+    }
+    return any;
+}
+
+static void generate_chunk(TrackGenerator* g, uint64_t* rows) {
+    const int words = g->words_per_row;
+    Rng rng;
+    rng_seed(&rng, hash_int(hash_int(hash_init, (long long) g->seed), g->next_chunk));
+
+    const double chance = chunk_density(g->next_chunk) / g->width;
+    const int max_per_row = (g->width + 1) / 2;
+    uint64_t open_lanes[words], stuck[words], options[words], one[words];
+    for (int y = 0; y < track_chunk_rows; y++) {
+        uint64_t* row = rows + (long) y * words;
+        memset(row, 0, sizeof(uint64_t) * words);
+        int count = 0;
+        for (int x = 0; x < g->width && count < max_per_row; x++) {
+            if (rng_chance(&rng, chance)) {
+                row[x >> 6] |= 1ull << (x & 63);
+                count++;
+            }
+        }
+
+        // every lane a car can be in needs a move, not only some of them: a car steers into a free cell of last_row
+        // next to it or stays, and that cell has to be free on this row. A stuck lane gets one of its moves opened,
+        // which may be the move of its neighbours too, so the stuck lanes are looked at again after each one
+        if (stuck_lanes(g, row, open_lanes, stuck)) {
+            do {
+                uint64_t lane;
+                const int w = pick_lane(&rng, stuck, words, &lane);
+                memset(one, 0, sizeof(one));
+                one[w] = lane;
+                spread(g, one, options);
+                for (int v = 0; v < words; v++)
+                    options[v] &= ~g->last_row[v]; // the lane itself is always one of them, a car is in it
+                uint64_t open;
+                const int ow = pick_lane(&rng, options, words, &open);
+                row[ow] &= ~open;
+            } while (stuck_lanes(g, row, open_lanes, stuck));
+            g->repaired_rows++;
+        }
+
+        // where the cars can be on this row: one move from where they were, into a lane free on both rows
+        spread(g, g->reachable, g->reachable);
+        for (int w = 0; w < words; w++)
+            g->reachable[w] &= ~g->last_row[w] & ~row[w];
+        memcpy(g->last_row, row, sizeof(uint64_t) * words);
+    }
+    g->next_chunk++;
+}
+
+static int generator_init(TrackGenerator* g, Arena* arena, const int width, const uint64_t seed) {
+    g->width = width;
+    g->words_per_row = (width + 63) / 64;
+    g->seed = seed;
+    g->next_chunk = 0;
+    g->repaired_rows = 0;
+    g->last_row = track_alloc(arena, sizeof(uint64_t) * g->words_per_row);
+    g->reachable = track_alloc(arena, sizeof(uint64_t) * g->words_per_row);
+    if (g->last_row == NULL || g->reachable == NULL)
+        return -1;
+
+    // the road starts empty, a car can be anywhere on it
+    memset(g->last_row, 0, sizeof(uint64_t) * g->words_per_row);
+    memset(g->reachable, 0xff, sizeof(uint64_t) * g->words_per_row);
+    spread(g, g->reachable, g->reachable);
+    return 0;
+}
+
+// ---- stream ----
+
+static uint64_t* chunk_slot(const TrackStream* s, const unsigned int chunk) {
+    const int slot = s->threaded ? chunk % track_queue_chunks : 0;
+    return s->chunks + (long) slot * track_chunk_rows * s->generator.words_per_row;
+}
+
+static void* generator_main(void* arg) {
+    TrackStream* s = arg;
+    for (;;) {
+        const unsigned int consumed = atomic_load_explicit(&s->consumed, memory_order_acquire);
+        const unsigned int produced = atomic_load_explicit(&s->produced, memory_order_relaxed);
+        if (atomic_load(&s->stopping))
+            break;
+        if (produced - consumed == track_queue_chunks) {
+            futex_wait(&s->consumed, consumed); // returns right away if a chunk was taken in the meantime
+            continue;
+        }
+        generate_chunk(&s->generator, chunk_slot(s, produced));
+        atomic_store_explicit(&s->produced, produced + 1, memory_order_release); // publishes the chunk
+    }
+    return NULL;
+}
+
+int track_stream_init(TrackStream* s, Arena* arena, const int width, const uint64_t seed, const int threaded) {
+    memset(s, 0, sizeof(TrackStream));
+    s->in_arena = arena != NULL;
+    s->threaded = threaded && arena == NULL;
+    s->row = track_chunk_rows;
+    if (generator_init(&s->generator, arena, width, seed) == -1)
+        return -1;
+
+    const int chunks = s->threaded ? track_queue_chunks : 1;
+    s->chunks = track_alloc(arena, sizeof(uint64_t) * chunks * track_chunk_rows * s->generator.words_per_row);
+    if (s->chunks == NULL)
+        return -1;
+
+    if (s->threaded && pthread_create(&s->thread, NULL, generator_main, s) != 0) {
+        s->threaded = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void track_stream_destroy(TrackStream* s) {
+    if (s->threaded) {
+        atomic_store(&s->stopping, 1);
+        atomic_fetch_add(&s->consumed, 1); // so the futex value changed when the generator looks again
+        futex_wake(&s->consumed);
+        pthread_join(s->thread, NULL);
+        s->threaded = 0;
+    }
+    if (!s->in_arena) {
+        free(s->chunks);
+        free(s->generator.last_row);
+        free(s->generator.reachable);
+    }
+    s->chunks = NULL;
+    s->generator.last_row = NULL;
+    s->generator.reachable = NULL;
+}
+
+static void next_chunk(TrackStream* s) {
+    if (!s->threaded) {
+        generate_chunk(&s->generator, s->chunks);
+        return;
+    }
+
+    if (s->has_chunk) {
+        atomic_fetch_add_explicit(&s->consumed, 1, memory_order_release); // hands the slot back
+        futex_wake(&s->consumed);
+    }
+    const unsigned int consumed = atomic_load_explicit(&s->consumed, memory_order_relaxed);
+    if (atomic_load_explicit(&s->produced, memory_order_acquire) == consumed) {
+        s->stalls++;
+        while (atomic_load_explicit(&s->produced, memory_order_acquire) == consumed)
+            sched_yield();
+    }
+}
+
+const uint64_t* track_next_row(TrackStream* s) {
+    if (s->row == track_chunk_rows) {
+        next_chunk(s);
+        s->has_chunk = 1;
+        s->row = 0;
+    }
+    const unsigned int chunk = atomic_load_explicit(&s->consumed, memory_order_relaxed);
+    s->rows_taken++;
+    return chunk_slot(s, chunk) + (long) s->row++ * s->generator.words_per_row;
+}
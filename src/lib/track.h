@@ -0,0 +1,68 @@
+#ifndef VGC_TRACK_H
+#define VGC_TRACK_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/*  Racing track generation. The road takes one new row per tick, the rows are made track_chunk_rows at a time by a
+ *  TrackGenerator. Chunk n depends on the seed, n and where the previous chunk left off (last_row, reachable), and
+ *  the chunks are always made in order, so the rows are the same whoever makes them and whenever.
+ *  Before a chunk leaves the generator it is checked row by row: the generator keeps the lanes a car could still be
+ *  in, a car moves at most one lane per row and only sideways into a free cell, and a row that would leave any of
+ *  those lanes without a move gets obstacles taken out until none is. A car that hasn't crashed yet always has a way
+ *  on, whatever it did before.
+ *  Obstacles are capped per row, and their density ramps up from chunk to chunk.
+ *
+ *  A TrackStream hands out the rows. Threaded, a generator thread stays track_queue_chunks ahead in a single
+ *  producer, single consumer ring and sleeps on a futex while the ring is full, so the tick thread only copies a row
+ *  that is ready. Roads in an arena (vgc-batch) make their chunk on the tick thread instead, one thread per road
+ *  would be thousands of threads there. Both give the same rows.
+ */
+
+#define track_chunk_rows 64
+#define track_queue_chunks 4
+
+#define track_start_density 1.0 // obstacles per row on average, in the first chunk
+#define track_full_density 2.5  // reached after track_ramp_chunks chunks, about 3 minutes at 5 ticks per second
+#define track_ramp_chunks 16
+
+typedef struct {
+    int width;
+    int words_per_row;
+    uint64_t seed;
+    long next_chunk;
+
+    uint64_t* last_row;  // the row made last
+    uint64_t* reachable; // the lanes a car that is still driving can be in on last_row
+    long repaired_rows;  // rows that walled a car off and had obstacles taken out
+} TrackGenerator;
+
+typedef struct {
+    TrackGenerator generator;
+
+    uint64_t* chunks; // track_queue_chunks chunks of rows, or one when not threaded
+    atomic_uint produced; // chunks written, only the generator moves it
+    atomic_uint consumed; // chunks done with, only the tick thread moves it, the generator waits on it
+    atomic_int stopping;
+    pthread_t thread;
+    int threaded;
+    int in_arena;
+
+    int row;       // next row in the current chunk, track_chunk_rows when a new chunk is needed
+    int has_chunk; // 0 before the first chunk
+    long rows_taken;
+    long stalls; // times the tick thread had to wait for a chunk, the generator fell behind
+} TrackStream;
+
+// returns -1 if the memory or the thread couldn't be had. Threaded doesn't apply to arena streams
+int track_stream_init(TrackStream* s, Arena* arena, int width, uint64_t seed, int threaded);
+// stops the generator thread, and frees the chunks unless they are in the arena
+void track_stream_destroy(TrackStream* s);
+
+// the next row, words_per_row words, valid until the next call
+const uint64_t* track_next_row(TrackStream* s);
+
+#endif
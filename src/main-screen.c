@@ -1,38 +1,53 @@
+#define _GNU_SOURCE // posix_spawn_file_actions_addtcsetpgrp_np
 #include <stdio.h>
 #include <stdlib.h>
-#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
 #include <string.h>
 #include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
 #include <ncurses.h>
-#include <sys/stat.h>
-
-
-int is_game(const char* filename) {
-    // check if it starts with "game_"
-    char game_prefix[] = "game_";
-    for (int i=0; i<5; i++) {
-        if (game_prefix[i] != filename[i])
-            return 0;
-    }
-
-    // add ./ to start
-    char* path = malloc(sizeof(char) * (strlen(filename) + 3));
-    strcpy(path, "./");
-    strcat(path, filename);
+#include <sys/wait.h>
+
+#include "lib/catalog.h"
+#include "lib/clock.h"
+#include "lib/event_loop.h"
+#include "lib/game_host.h"
+#include "lib/input.h"
+#include "lib/perf.h"
+#include "lib/render.h"
+#include "lib/scheduler.h"
+#include "lib/scores.h"
+#include "lib/search.h"
+#include "lib/trace.h"
+
+
+#define max_plugins 16
+#define shown_scores 5
+#define list_header_y 13
+#define list_y 14 // the games, one per row down to the bottom of the screen
+
+// a game .so that was dlopen()ed once and stays loaded, running it again is only a function call
+typedef struct {
+    char name[max_game_name];
+    long long mtime_ns; // of the file that was loaded, a rebuilt plugin gets loaded again
+    void* handle;
+    const VgcGame* game;
+} LoadedPlugin;
 
-    // check if it is an executable
-    struct stat file_stat;
-    if (stat(path, &file_stat) == -1) {
-        perror("could not get file info");
-        return 0;
-    }
-    // check if it is a regular file and has execute permission
-    if ( !S_ISREG(file_stat.st_mode) || !(file_stat.st_mode & S_IXUSR)) {
-        return 0;
-    }
+#define max_suspended 4 // stopped games kept for resuming, suspending one more ends the one left alone longest
 
-    return 1;
-}
+// a game left with ctrl+z, it shows up after the catalog's games as "resume <name>"
+typedef struct {
+    char name[max_game_name]; // the catalog entry it was started from
+    pid_t pid;                // its stopped process, 0 for a plugin
+    const VgcGame* game;      // a plugin's game, its state is in session
+    GameSession session;
+    long long suspended_ns;   // the one suspended longest ago is ended first
+    double played;            // seconds it ran so far
+} SuspendedGame;
 
 typedef struct {
     enum buttons {
@@ -42,26 +57,80 @@ typedef struct {
     int current_button;
     int num_buttons;
 
-    char** game_names;
-    int current_game_idx;
-    int num_games;
+    Catalog* catalog; // the games in the current directory, kept up to date through inotify
+    int current_game_idx; // the catalog's games and then the suspended ones, -1 when the search matches none
+
+    GameSearch* search; // over the same games as current_game_idx, indexed again when the catalog changes
+    int searching;      // keys go into the query instead of moving around
+    int current_match;  // where current_game_idx is in the search results
+    int list_top;       // the first result on the screen
+
+    GameInfo* infos;    // per catalog entry, read from the game's file the first time it is on the screen
+    char* info_read;
+    int num_infos;
+
+    char last_run[128]; // how the last game ended, shown under the buttons
+
+    LoadedPlugin plugins[max_plugins];
+    int num_plugins;
+
+    SuspendedGame suspended[max_suspended];
+    int num_suspended;
 } MainScreen;
 
 MainScreen* main_screen;
+Renderer* renderer;
+EventLoop* loop;
+InputQueue menu_input; // the menu's keys, decoded and timed like a game's
+
+// the suspended game at the current menu position, NULL when it is one of the catalog's games
+SuspendedGame* current_suspended(MainScreen* main_screen) {
+    const int i = main_screen->current_game_idx - main_screen->catalog->num_entries;
+    return i >= 0 && i < main_screen->num_suspended ? &main_screen->suspended[i] : NULL;
+}
+
+const char* current_game_name(MainScreen* main_screen) {
+    const SuspendedGame* suspended = current_suspended(main_screen);
+    if (suspended != NULL)
+        return suspended->name;
+    if (main_screen->current_game_idx == -1)
+        return main_screen->catalog->num_entries + main_screen->num_suspended == 0 ? "(no games)" : "(no match)";
+    return main_screen->catalog->entries[main_screen->current_game_idx].name;
+}
 
-MainScreen* initialize_main_screen(char** game_names, int num_of_games) {
+void forget_game_infos(MainScreen* main_screen);
+void reindex_games(MainScreen* main_screen);
+
+// NULL if it couldn't be allocated
+MainScreen* initialize_main_screen(Catalog* catalog) {
     main_screen = malloc(sizeof(MainScreen));
+    if (main_screen == NULL)
+        return NULL;
+    main_screen->search = create_search();
+    if (main_screen->search == NULL) {
+        free(main_screen);
+        return main_screen = NULL;
+    }
     main_screen->current_button = play;
     main_screen->num_buttons = 2;
-    main_screen->game_names = game_names;
+    main_screen->catalog = catalog;
     main_screen->current_game_idx = 0;
-    main_screen->num_games = num_of_games;
+    main_screen->last_run[0] = '\0';
+    main_screen->num_plugins = 0;
+    main_screen->num_suspended = 0;
+    main_screen->searching = 0;
+    main_screen->current_match = 0;
+    main_screen->list_top = 0;
+    main_screen->infos = NULL;
+    main_screen->info_read = NULL;
+    main_screen->num_infos = 0;
+    forget_game_infos(main_screen);
+    reindex_games(main_screen);
     return main_screen;
 }
 
 void update_screen_position(const int x, const int y, const char c) {
-    mvprintw(y, x, "%c", c);
-    refresh();
+    renderer_put(renderer, x, y, c); // sent to the terminal with the rest of the frame in renderer_flush
 }
 
 #define SELECT 1
@@ -97,34 +166,209 @@ void select_button(MainScreen* main_screen, const int button, const int select)
     }
 }
 
-void print_whole_screen(MainScreen* main_screen) {
-    clear();
-    printw("=== Virtual Game Console ===\n");
-    printw("Use keys a and d to select button\n");
-    printw("Use keys w and s to change game\n");
-    printw("Press enter to select\n");
-    printw("Press q to quit\n");
-    printw("\n");
-
-    printw("        Current game: %s\n", main_screen->game_names[main_screen->current_game_idx]);
-    printw("    play    quit    \n");
-    select_button(main_screen, main_screen->current_button, SELECT);
+int is_plugin_name(const char* name) {
+    const size_t len = strlen(name);
+    return len > 3 && strcmp(name + len - 3, ".so") == 0;
+}
+
+// the best scores of the current game, from the score index, a plugin and its executable share them
+void print_top_scores(MainScreen* main_screen) {
+    char game[max_game_name];
+    snprintf(game, sizeof(game), "%s", current_game_name(main_screen));
+    if (is_plugin_name(game))
+        game[strlen(game) - 3] = '\0';
+
+    ScoreRecord top[shown_scores];
+    const int n = scores_read_top(game, top, shown_scores);
+    char line[128] = "";
+    int used = n > 0 ? snprintf(line, sizeof(line), "          Top scores:") : 0;
+    for (int i = 0; i < n; i++)
+        used += snprintf(line + used, sizeof(line) - used, "  %lld", (long long) top[i].score);
+    renderer_print(renderer, 0, 11, "%-70s", line);
+}
+
+int list_rows(void) {
+    const int rows = renderer->rows - list_y;
+    return rows > 0 ? rows : 0;
+}
+
+// the info note of a catalog entry, only the entries that make it onto the screen ever have their file mapped
+const GameInfo* game_info(MainScreen* main_screen, const int entry) {
+    if (entry < 0 || entry >= main_screen->num_infos)
+        return NULL;
+    if (!main_screen->info_read[entry]) {
+        catalog_game_info(main_screen->catalog, entry, &main_screen->infos[entry]); // left empty if it has none
+        main_screen->info_read[entry] = 1;
+    }
+    return &main_screen->infos[entry];
+}
+
+// the catalog changed and an index may be another game now, the infos are read again as they show up
+void forget_game_infos(MainScreen* main_screen) {
+    int n = main_screen->catalog->num_entries;
+    if (n > main_screen->num_infos) {
+        GameInfo* infos = realloc(main_screen->infos, n * sizeof(GameInfo));
+        if (infos != NULL)
+            main_screen->infos = infos;
+        char* info_read = realloc(main_screen->info_read, n);
+        if (info_read != NULL)
+            main_screen->info_read = info_read;
+        if (infos == NULL || info_read == NULL)
+            n = main_screen->num_infos; // the ones past it are shown without their info
+    }
+    main_screen->num_infos = n;
+    memset(main_screen->info_read, 0, n);
+}
+
+// one game of the list: its name, then its title, description and author if its file has them
+void format_list_entry(MainScreen* main_screen, const int idx, const int current, char* line, const size_t size) {
+    const Catalog* catalog = main_screen->catalog;
+    const char* resume = "";
+    const char* name;
+    int entry = idx;
+    if (idx >= catalog->num_entries) {
+        name = main_screen->suspended[idx - catalog->num_entries].name;
+        resume = "resume ";
+        entry = catalog_find(catalog, name);
+    }
+    else
+        name = catalog->entries[idx].name;
+
+    const GameInfo* info = game_info(main_screen, entry);
+    const int has_info = info != NULL && info->title[0] != '\0';
+    snprintf(line, size, "%c %s%-*s %-12s %s%s%s%s", current ? '>' : ' ', resume, 30 - (int) strlen(resume), name,
+             has_info ? info->title : "", has_info ? info->description : "",
+             has_info && info->author[0] != '\0' ? " (" : "", has_info ? info->author : "",
+             has_info && info->author[0] != '\0' ? ")" : "");
+}
+
+// the search line and the page of results around the current game. The renderer only sends the rows that changed
+void print_game_list(MainScreen* main_screen) {
+    int count;
+    const int* results = search_results(main_screen->search, &count);
+    const int total = main_screen->catalog->num_entries + main_screen->num_suspended;
+    const int width = renderer->cols < 255 ? renderer->cols : 255;
+    char line[256];
+
+    const GameSearch* search = main_screen->search;
+    if (main_screen->searching)
+        snprintf(line, sizeof(line), "Search: %s_   %d of %d games, enter plays, esc clears", search->query, count,
+                 total);
+    else if (search->length > 0)
+        snprintf(line, sizeof(line), "Search: %s   %d of %d games, / to change it, esc clears", search->query, count,
+                 total);
+    else
+        snprintf(line, sizeof(line), "%d games, / to search, page up and page down to page", total);
+    renderer_print(renderer, 0, list_header_y, "%-*s", width, line);
+
+    for (int row = 0; row < list_rows(); row++) {
+        const int match = main_screen->list_top + row;
+        line[0] = '\0';
+        if (match < count)
+            format_list_entry(main_screen, results[match], match == main_screen->current_match, line, sizeof(line));
+        renderer_print(renderer, 0, list_y + row, "%-*s", width, line);
+    }
+}
+
+// makes result match the current game, and scrolls the list just enough to have it on the screen
+void select_match(MainScreen* main_screen, int match) {
+    int count;
+    const int* results = search_results(main_screen->search, &count);
+    if (count == 0) {
+        main_screen->current_match = 0;
+        main_screen->current_game_idx = -1;
+        main_screen->list_top = 0;
+        return;
+    }
+    match = match < 0 ? 0 : match >= count ? count - 1 : match;
+    main_screen->current_match = match;
+    main_screen->current_game_idx = results[match];
+
+    const int rows = list_rows();
+    if (match < main_screen->list_top)
+        main_screen->list_top = match;
+    else if (rows > 0 && match >= main_screen->list_top + rows)
+        main_screen->list_top = match - rows + 1;
+    const int last_top = count > rows ? count - rows : 0;
+    if (main_screen->list_top > last_top)
+        main_screen->list_top = last_top;
+}
 
-    refresh();
+// stays on game idx if the search still matches it, goes to the best match otherwise
+void select_game(MainScreen* main_screen, const int idx) {
+    int count;
+    const int* results = search_results(main_screen->search, &count);
+    for (int m = 0; m < count; m++) {
+        if (results[m] == idx) {
+            select_match(main_screen, m);
+            return;
+        }
+    }
+    select_match(main_screen, 0);
 }
 
-void free_game_names(char** game_names, int num_of_games) {
-    for (int i=0; i<num_of_games; i++) {
-        free(game_names[i]);
+// the catalog or the suspended games changed, both are searched as one list
+void reindex_games(MainScreen* main_screen) {
+    const Catalog* catalog = main_screen->catalog;
+    const int total = catalog->num_entries + main_screen->num_suspended;
+    const char** names = malloc((total + 1) * sizeof(char*));
+    if (names == NULL) {
+        // the old list stays while its indices are still games, they get their names back on the next reindex
+        if (main_screen->search->num_names > total)
+            search_reset(main_screen->search, NULL, 0);
+        select_game(main_screen, main_screen->current_game_idx);
+        return;
     }
-    free(game_names);
+    for (int i = 0; i < catalog->num_entries; i++)
+        names[i] = catalog->entries[i].name;
+    for (int i = 0; i < main_screen->num_suspended; i++)
+        names[catalog->num_entries + i] = main_screen->suspended[i].name;
+    search_reset(main_screen->search, names, total);
+    free(names);
+    select_game(main_screen, main_screen->current_game_idx);
+}
+
+// the renderer only sends the characters that differ, so rewriting the whole padded line is as cheap as patching it
+void print_current_game(MainScreen* main_screen) {
+    int game_names_y = 6;
+    int game_name_start = 22;
+    const char* resume = current_suspended(main_screen) != NULL ? "resume " : "";
+    renderer_print(renderer, game_name_start, game_names_y, "%s%-*s", resume, max_game_name, current_game_name(main_screen));
+    print_top_scores(main_screen);
+    print_game_list(main_screen);
 }
 
-char** game_names;
-int num_of_games;
+void print_whole_screen(MainScreen* main_screen) {
+    renderer_clear(renderer);
+    renderer_print(renderer, 0, 0, "=== Virtual Game Console ===");
+    renderer_print(renderer, 0, 1, "Use keys a and d to select button");
+    renderer_print(renderer, 0, 2, "Use keys w and s to change game, page up and page down to page");
+    renderer_print(renderer, 0, 3, "Press / to search, enter to select");
+    renderer_print(renderer, 0, 4, "Press q to quit");
+
+    renderer_print(renderer, 0, 6, "        Current game:");
+    print_current_game(main_screen);
+    renderer_print(renderer, 0, 7, "    play    quit    ");
+    select_button(main_screen, main_screen->current_button, SELECT);
+    renderer_print(renderer, 0, 9, "%s", main_screen->last_run);
+
+    renderer_flush(renderer);
+}
+
+void end_suspended(MainScreen* main_screen, int i);
 
 void free_main_screen(MainScreen* main_screen) {
-    free_game_names(main_screen->game_names, main_screen->num_games);
+    if (main_screen == NULL)
+        return;
+    // before the plugins are closed, a suspended plugin's game still needs its code to finish
+    while (main_screen->num_suspended > 0)
+        end_suspended(main_screen, 0);
+    for (int i = 0; i < main_screen->num_plugins; i++)
+        dlclose(main_screen->plugins[i].handle);
+    free_search(main_screen->search);
+    free(main_screen->infos);
+    free(main_screen->info_read);
+    free_catalog(main_screen->catalog);
     free(main_screen);
 }
 
@@ -132,84 +376,492 @@ void cleanup() {
     free_main_screen(main_screen);
     endwin();
     system("clear");
-}
-void handle_sigint(int sig) {
-    cleanup();
-    exit(0);
-}
-void handle_sigterm(int sig) {
-    cleanup();
-    exit(0);
+    renderer_report_stats(renderer, "main-screen", stderr);
+    input_report_stats(&menu_input, "main-screen", stderr);
+    free_renderer(renderer);
+    free_event_loop(loop);
+    trace_stop();
+    perf_stop();
+    scores_stop();
 }
 
 void slide_game(MainScreen* main_screen, int direction) {
-    int prev_idx = main_screen->current_game_idx;
-    int num_games = main_screen->num_games;
-    int next_game_idx = (prev_idx + direction + num_games) % num_games;
+    int num_games;
+    search_results(main_screen->search, &num_games);
+    if (num_games == 0)
+        return;
 
-    main_screen->current_game_idx = next_game_idx;
+    select_match(main_screen, (main_screen->current_match + direction + num_games) % num_games);
+    print_current_game(main_screen);
+}
 
-    int game_names_y = 6;
-    int game_name_start = 22;
-    int game_name_end = 22 + strlen(main_screen->game_names[prev_idx]);
+// a screenful of games up or down, it stops at the first and last one instead of going around
+void page_games(MainScreen* main_screen, const int direction) {
+    const int rows = list_rows();
+    select_match(main_screen, main_screen->current_match + direction * (rows > 1 ? rows - 1 : 1));
+    print_current_game(main_screen);
+}
+
+// the query changed, the best match of the new one becomes the current game
+void search_changed(MainScreen* main_screen) {
+    select_match(main_screen, 0);
+    print_current_game(main_screen);
+}
+
+// back to every game, staying on the current one
+void clear_search(MainScreen* main_screen) {
+    main_screen->searching = 0;
+    search_clear(main_screen->search);
+    select_game(main_screen, main_screen->current_game_idx);
+    print_current_game(main_screen);
+}
 
-    int i = 0;
-    while (i < strlen(main_screen->game_names[next_game_idx])) {
-        update_screen_position(game_name_start + i, game_names_y, main_screen->game_names[next_game_idx][i]);
-        i++;
+// while the search line is typed, printable keys and backspace edit the query. Returns 0 for the other keys, the
+// arrows and enter do the same as without a search
+int handle_search_key(MainScreen* main_screen, const int ch) {
+    if (ch == KEY_BACKSPACE || ch == 127 || ch == '\b') {
+        if (main_screen->search->length == 0) {
+            main_screen->searching = 0; // one more backspace leaves the search line
+            print_current_game(main_screen);
+            return 1;
+        }
+        search_pop(main_screen->search);
     }
-    while (i <= game_name_end) {
-        update_screen_position(game_name_start + i, game_names_y, ' ');
-        i++;
+    else if (ch >= ' ' && ch <= '~') {
+        if (search_push(main_screen->search, (char) ch) == -1)
+            return 1;
     }
+    else
+        return 0;
+    search_changed(main_screen);
+    return 1;
+}
+
+// a game was added, removed or changed on disk, stay on the same game if it is still there
+void refresh_catalog(MainScreen* main_screen) {
+    char current[max_game_name];
+    snprintf(current, sizeof(current), "%s", current_game_name(main_screen));
+    const int suspended_idx = main_screen->current_game_idx - main_screen->catalog->num_entries;
+
+    if (!catalog_handle_events(main_screen->catalog))
+        return;
+    forget_game_infos(main_screen);
+
+    // the suspended games come after the catalog's, however many games it has now
+    const int idx = catalog_find(main_screen->catalog, current);
+    if (suspended_idx >= 0 && suspended_idx < main_screen->num_suspended)
+        main_screen->current_game_idx = main_screen->catalog->num_entries + suspended_idx;
+    else
+        main_screen->current_game_idx = idx; // or -1 and the best match of the search
+    reindex_games(main_screen);
+    print_current_game(main_screen);
 }
 
 void init_ncurses() {
-    initscr();
-    noecho();
-    cbreak();
-    keypad(stdscr, TRUE);
-    nodelay(stdscr, TRUE);
-    curs_set(0);
+    init_terminal();
+}
+
+extern char** environ;
+
+// starts ./<game name> in its own process group that owns the terminal, and waits for it. Returns the pid or -1
+pid_t spawn_game(const char* path, char** argv) {
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    // the game gets the signal mask we started with and default handlers, not our blocked signalfd setup
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTERM);
+    sigaddset(&defaults, SIGWINCH);
+    sigaddset(&defaults, SIGTTOU);
+    posix_spawnattr_setsigmask(&attr, &loop->original_mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+
+    // own process group in the foreground, so ctrl+c from the keyboard only goes to the game and not to us
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (isatty(STDIN_FILENO)) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+        posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    const int error = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+// back in the foreground after the game, SIGTTOU has to be blocked or tcsetpgrp from the background stops us
+void take_back_terminal() {
+    if (!isatty(STDIN_FILENO))
+        return;
+
+    sigset_t ttou, old;
+    sigemptyset(&ttou);
+    sigaddset(&ttou, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &ttou, &old);
+    tcsetpgrp(STDIN_FILENO, getpgrp());
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+// where a game is exec'd or dlopen'd from: the current directory, or the game's sealed memfd when we run a bundle.
+// Returns -1 with errno set if the game can't be taken out of the bundle
+int game_path(MainScreen* main_screen, const char* game_name, char* path, const size_t size) {
+    Bundle* bundle = main_screen->catalog->bundle;
+    if (bundle == NULL) {
+        snprintf(path, size, "./%s", game_name);
+        return 0;
+    }
+
+    // exec and dlopen resolve the path before close-on-exec fds are closed, so the memfd can stay CLOEXEC
+    const int fd = bundle_game_fd(bundle, bundle_find(bundle, game_name));
+    if (fd == -1)
+        return -1;
+    snprintf(path, size, "/proc/self/fd/%d", fd);
+    return 0;
+}
+
+const char* game_path_error(const int error) {
+    return error == EBADMSG ? "checksum mismatch, the bundle is damaged" : strerror(error);
+}
+
+// ends suspended game i: a process wakes up without the terminal and with SIGTERM waiting, so it quits without
+// drawing anything, a plugin's game is finished right here. Either way its score is kept
+void end_suspended(MainScreen* main_screen, const int i) {
+    SuspendedGame* g = &main_screen->suspended[i];
+    if (g->pid != 0) {
+        kill(g->pid, SIGTERM);
+        kill(g->pid, SIGCONT);
+        int status;
+        while (waitpid(g->pid, &status, WUNTRACED) == -1 && errno == EINTR) {}
+        if (WIFSTOPPED(status)) { // it touched the terminal after all
+            kill(g->pid, SIGKILL);
+            while (waitpid(g->pid, &status, 0) == -1 && errno == EINTR) {}
+        }
+    }
+    else
+        end_suspended_game(g->game, &g->session);
+
+    memmove(g, g + 1, (main_screen->num_suspended - i - 1) * sizeof(SuspendedGame));
+    main_screen->num_suspended--;
+    const int position = main_screen->catalog->num_entries + i;
+    if (main_screen->current_game_idx > position)
+        main_screen->current_game_idx--;
+    else if (main_screen->current_game_idx == position)
+        main_screen->current_game_idx = 0;
+    reindex_games(main_screen);
+}
+
+// takes the game out of the suspended list, to be resumed. The menu goes back to the game it was started from
+SuspendedGame take_suspended(MainScreen* main_screen, const int i) {
+    const SuspendedGame g = main_screen->suspended[i];
+    memmove(&main_screen->suspended[i], &main_screen->suspended[i + 1],
+            (main_screen->num_suspended - i - 1) * sizeof(SuspendedGame));
+    main_screen->num_suspended--;
+    main_screen->current_game_idx = catalog_find(main_screen->catalog, g.name);
+    reindex_games(main_screen);
+    return g;
+}
+
+// adds a game that was just suspended to the menu and moves the menu to it, so enter resumes it right away
+void keep_suspended(MainScreen* main_screen, const SuspendedGame* g) {
+    if (main_screen->num_suspended == max_suspended) {
+        int oldest = 0;
+        for (int i = 1; i < main_screen->num_suspended; i++) {
+            if (main_screen->suspended[i].suspended_ns < main_screen->suspended[oldest].suspended_ns)
+                oldest = i;
+        }
+        end_suspended(main_screen, oldest);
+    }
+    main_screen->suspended[main_screen->num_suspended] = *g;
+    main_screen->suspended[main_screen->num_suspended].suspended_ns = monotonic_ns();
+    main_screen->current_game_idx = main_screen->catalog->num_entries + main_screen->num_suspended++;
+    reindex_games(main_screen);
+}
+
+// until the game exits or stops on ctrl+z, returns 1 if it stopped
+int wait_for_game(const pid_t pid, int* status) {
+    while (waitpid(pid, status, WUNTRACED) == -1 && errno == EINTR) {}
+    return WIFSTOPPED(*status);
+}
+
+// how a spawned game ended, or that it is suspended, goes under the buttons.
+// started is "launched" or "resumed", started_ms how long that took
+void report_game(MainScreen* main_screen, const char* game_name, const int status, const double runtime,
+                 const char* started, const double started_ms) {
+    if (WIFSTOPPED(status))
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "%s suspended after %.1f s, %s in %.2f ms",
+                 game_name, runtime, started, started_ms);
+    else if (WIFSIGNALED(status))
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run),
+                 "%s killed by signal %d after %.1f s, %s in %.2f ms", game_name, WTERMSIG(status), runtime, started,
+                 started_ms);
+    else
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "%s exited with %d after %.1f s, %s in %.2f ms",
+                 game_name, WEXITSTATUS(status), runtime, started, started_ms);
+}
+
+// the game had the terminal, now it is ours again
+void return_to_menu(MainScreen* main_screen) {
+    take_back_terminal();
+    reset_prog_mode(); // our modes again, including the hidden cursor
+    renderer_resize_to_terminal(renderer); // the terminal may have been resized while the game ran
+    renderer_invalidate(renderer); // the game drew over everything, repaint the whole menu
+    print_whole_screen(main_screen);
 }
 
 void start_game(MainScreen* main_screen) {
+    const long long requested = monotonic_ns();
+
+    if (main_screen->catalog->num_entries == 0)
+        return;
+
     int game = main_screen->current_game_idx;
-    // execute the game executable on the current directory as a child process
-    char* game_name = main_screen->game_names[game];
-    char* command = malloc(sizeof(char) * (strlen(game_name) + 3));
-    strcpy(command, "./");
-    strcat(command, game_name);
+    // execute the game executable as a child process, without a shell in between
+    const char* game_name = current_game_name(main_screen);
+    char path[512];
+    if (game_path(main_screen, game_name, path, sizeof(path)) == -1) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not start %s: %s", game_name,
+                 game_path_error(errno));
+        print_whole_screen(main_screen);
+        return;
+    }
 
-    system(command); // runs the game as a child and waits for it to finish
+    // when the console is traced, the game writes its own trace next to ours, <trace file>.<game name>
+    char game_trace[512];
+    char* argv[] = {(char*) game_name, NULL, NULL, NULL};
+    if (trace_path() != NULL) {
+        snprintf(game_trace, sizeof(game_trace), "%s.%s", trace_path(), game_name);
+        argv[1] = "--trace";
+        argv[2] = game_trace;
+    }
 
-    curs_set(0); // WHY DOESN'T THIS WORK
+    def_prog_mode(); // remember our terminal modes to come back to them after the game
+    endwin();        // and hand the terminal over in its normal state
 
-    free(command);
-    init_ncurses();
-    refresh();
+    trace_event(TRACE_LAUNCH_BEGIN, game);
+    const pid_t pid = spawn_game(path, argv);
+    const long long launched = monotonic_ns(); // posix_spawn returns once the game is exec'd
+
+    int status = 0;
+    if (pid == -1) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not start %s: %s", game_name,
+                 strerror(errno));
+    }
+    else {
+        const int stopped = wait_for_game(pid, &status);
+        const double runtime = (monotonic_ns() - launched) / 1e9;
+        report_game(main_screen, game_name, status, runtime, "launched", (launched - requested) / 1e6);
+        if (stopped) {
+            SuspendedGame g = {.pid = pid, .played = runtime};
+            snprintf(g.name, sizeof(g.name), "%s", game_name);
+            keep_suspended(main_screen, &g);
+        }
+    }
+    trace_event(TRACE_LAUNCH_END, status);
+    return_to_menu(main_screen);
+}
+
+// continues a stopped game in the foreground: it repaints itself from its own screen, nothing is started again
+void resume_process(MainScreen* main_screen, SuspendedGame g) {
+    const long long requested = monotonic_ns();
+    def_prog_mode();
+    endwin();
+
+    trace_event(TRACE_LAUNCH_BEGIN, main_screen->current_game_idx);
+    if (isatty(STDIN_FILENO))
+        tcsetpgrp(STDIN_FILENO, g.pid); // its own process group, spawn_game made it
+    kill(g.pid, SIGCONT);
+    const long long resumed = monotonic_ns();
+
+    int status;
+    const int stopped = wait_for_game(g.pid, &status);
+    g.played += (monotonic_ns() - resumed) / 1e9;
+    report_game(main_screen, g.name, status, g.played, "resumed", (resumed - requested) / 1e6);
+    if (stopped)
+        keep_suspended(main_screen, &g);
+    trace_event(TRACE_LAUNCH_END, status);
+    return_to_menu(main_screen);
+}
+
+// dlopen()s a game .so once and keeps it loaded. Returns its VgcGame, or NULL with the reason in last_run
+const VgcGame* load_plugin(MainScreen* main_screen, const CatalogEntry* entry) {
+    for (int i = 0; i < main_screen->num_plugins; i++) {
+        LoadedPlugin* plugin = &main_screen->plugins[i];
+        if (strcmp(plugin->name, entry->name) != 0)
+            continue;
+        if (plugin->mtime_ns == entry->mtime_ns)
+            return plugin->game;
+
+        // rebuilt since we loaded it, drop the old one and load it again below. Its suspended games need the old code
+        for (int j = main_screen->num_suspended - 1; j >= 0; j--) {
+            if (main_screen->suspended[j].game == plugin->game)
+                end_suspended(main_screen, j);
+        }
+        dlclose(plugin->handle);
+        main_screen->plugins[i] = main_screen->plugins[--main_screen->num_plugins];
+        break;
+    }
+
+    if (main_screen->num_plugins == max_plugins) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not load %s: too many plugins loaded",
+                 entry->name);
+        return NULL;
+    }
+
+    char path[512];
+    if (game_path(main_screen, entry->name, path, sizeof(path)) == -1) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not load %s: %s", entry->name,
+                 game_path_error(errno));
+        return NULL;
+    }
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not load %s: %s", entry->name,
+                 dlerror());
+        return NULL;
+    }
+
+    const VgcGame* game = dlsym(handle, VGC_GAME_SYMBOL);
+    if (game == NULL || game->abi_version != VGC_GAME_ABI) {
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not load %s: %s", entry->name,
+                 game == NULL ? "not a game plugin" : "built for another plugin ABI");
+        dlclose(handle);
+        return NULL;
+    }
+
+    LoadedPlugin* plugin = &main_screen->plugins[main_screen->num_plugins++];
+    snprintf(plugin->name, sizeof(plugin->name), "%s", entry->name);
+    plugin->mtime_ns = entry->mtime_ns;
+    plugin->handle = handle;
+    plugin->game = game;
+    return game;
+}
+
+// runs a plugin's session, new or suspended, in our own screen. A game suspended again goes back into the menu.
+// started is "loaded" or "resumed", returns GAME_QUIT if a quit signal arrived during the game
+int play_plugin(MainScreen* main_screen, SuspendedGame* g, const long long requested, const char* started) {
+    const VgcGame* game = g->game;
+    Scheduler* scheduler = create_scheduler(game->tick_hz, game->render_hz);
+    const long long launched = monotonic_ns();
+    const int result = scheduler != NULL ? run_game(game, loop, renderer, scheduler, &g->session) : GAME_FAILED;
+    g->played += (monotonic_ns() - launched) / 1e9;
+    const double launch_ms = (launched - requested) / 1e6;
+    free_scheduler(scheduler);
+    scores_sync(); // the game is over, waiting for its score to be written is fine now and the menu shows it
+    trace_event(TRACE_LAUNCH_END, result);
+
+    if (result == GAME_FAILED)
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "Could not start %s: out of memory",
+                 g->name);
+    else
+        snprintf(main_screen->last_run, sizeof(main_screen->last_run), "%s %s after %.1f s, %s in %.2f ms", g->name,
+                 result == GAME_SUSPENDED ? "suspended" : "left", g->played, started, launch_ms);
+    if (result == GAME_SUSPENDED)
+        keep_suspended(main_screen, g);
+
+    // same renderer as the game, so only the cells where the game and the menu differ get sent, no flicker
     print_whole_screen(main_screen);
+    return result == GAME_SUSPENDED ? GAME_LEFT : result;
+}
+
+// runs a game .so inside our own screen and event loop, returns GAME_QUIT if a quit signal arrived during the game
+int start_plugin(MainScreen* main_screen) {
+    const long long requested = monotonic_ns();
+
+    const int game_idx = main_screen->current_game_idx;
+    const CatalogEntry* entry = &main_screen->catalog->entries[game_idx];
+    char game_name[max_game_name];
+    snprintf(game_name, sizeof(game_name), "%s", entry->name);
+
+    trace_event(TRACE_LAUNCH_BEGIN, game_idx);
+    const VgcGame* game = load_plugin(main_screen, entry);
+    if (game == NULL) {
+        trace_event(TRACE_LAUNCH_END, GAME_FAILED);
+        print_whole_screen(main_screen);
+        return GAME_LEFT;
+    }
+
+    SuspendedGame g = {.game = game};
+    snprintf(g.name, sizeof(g.name), "%s", game_name);
+    g.session.seed = time(NULL);
+    g.session.keep_on_suspend = 1;
+    return play_plugin(main_screen, &g, requested, "loaded");
+}
+
+// picks a suspended game up where it was left, returns GAME_QUIT if a quit signal arrived during the game
+int resume_game(MainScreen* main_screen) {
+    const long long requested = monotonic_ns();
+    SuspendedGame g = take_suspended(main_screen, main_screen->current_game_idx - main_screen->catalog->num_entries);
+    if (g.pid != 0) {
+        resume_process(main_screen, g);
+        return GAME_LEFT;
+    }
+    trace_event(TRACE_LAUNCH_BEGIN, main_screen->current_game_idx);
+    return play_plugin(main_screen, &g, requested, "resumed");
 }
 
-void handle_input(MainScreen* main_screen, char ch) {
+// returns GAME_QUIT when the console should exit
+int handle_input(MainScreen* main_screen, const int ch) {
+    if (main_screen->searching && handle_search_key(main_screen, ch))
+        return GAME_LEFT;
+
     switch (ch) {
-        case 'w': // slide to next game
+        case 'w': // slide to previous game
+        case KEY_UP:
+            slide_game(main_screen, -1);
+            break;
+        case 's': // slide to next game
+        case KEY_DOWN:
             slide_game(main_screen, 1);
             break;
-        case 's': // slide to previous game
-            slide_game(main_screen, -1);
+        case KEY_PPAGE:
+            page_games(main_screen, -1);
+            break;
+        case KEY_NPAGE:
+            page_games(main_screen, 1);
             break;
+        case '/':
+            main_screen->searching = 1;
+            print_game_list(main_screen);
+            break;
+        case 27: // esc
+            clear_search(main_screen);
+            break;
+        case 'q':
+            return GAME_QUIT;
         case 'a':
+        case KEY_LEFT:
             select_button(main_screen, quit, DESELECT);
             select_button(main_screen, play, SELECT);
             break;
         case 'd':
+        case KEY_RIGHT:
             select_button(main_screen, play, DESELECT);
             select_button(main_screen, quit, SELECT);
             break;
         case '\n': // enter
+        case KEY_ENTER:
+            main_screen->searching = 0; // the query stays, but q quits again after the game
             if (main_screen->current_button == play) {
-                start_game(main_screen);
+                if (main_screen->current_game_idx == -1)
+                    print_game_list(main_screen);
+                else if (current_suspended(main_screen) != NULL)
+                    return resume_game(main_screen);
+                else if (is_plugin_name(current_game_name(main_screen)))
+                    return start_plugin(main_screen);
+                else
+                    start_game(main_screen);
             }
             else if (main_screen->current_button == quit) {
                 cleanup();
@@ -217,65 +869,105 @@ void handle_input(MainScreen* main_screen, char ch) {
             }
             break;
         default:
-            return;
+            break;
     }
+    return GAME_LEFT;
 }
 
 
-int main() {
-    signal(SIGINT, handle_sigint);
-    signal(SIGTERM, handle_sigterm);
-
-    num_of_games = 0;
-
-    DIR* current_directory = opendir(".");
-    if (current_directory == NULL) {
-        printf("Unable to open current directory\n");
+int main(int argc, char** argv) {
+    // SIGINT and SIGTERM arrive through the event loop, so cleanup() runs from main and not from a signal handler
+    loop = create_event_loop();
+    if (loop == NULL) {
+        printf("Failed to set up the event loop\n");
         return 1;
     }
-
-    struct dirent* dir_entry;
-
-    // get the number of games
-    while ((dir_entry = readdir(current_directory)) != NULL) {
-        if (is_game(dir_entry->d_name)) {
-            num_of_games++;
-        }
+    event_loop_catch_suspend(loop); // ctrl+z in a plugin suspends the game, not us. Before any thread starts
+    if (trace_start_from_args(argc, argv, "main-screen") == -1) { // after the event loop, so the writer thread has the signals blocked too
+        free_event_loop(loop);
+        return 1;
     }
-    rewinddir(current_directory);
 
-    game_names = malloc(sizeof(char*) * num_of_games);
+    // the games come from a bundle with --bundle <file>, from the current directory otherwise
+    const char* bundle_path = NULL;
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--bundle") == 0)
+            bundle_path = argv[i + 1];
+    }
 
-    // get the names of the games
-    int i = 0;
-    while ((dir_entry = readdir(current_directory)) != NULL) {
-        if (is_game(dir_entry->d_name)) {
-            game_names[i] = malloc(sizeof(char) * strlen(dir_entry->d_name) + 1); // +1 for the \0
-            strcpy(game_names[i], dir_entry->d_name);
-            i++;
-        }
+    Catalog* catalog = bundle_path != NULL ? load_catalog_bundle(bundle_path) : load_catalog(".");
+    if (catalog == NULL) {
+        if (bundle_path != NULL)
+            printf("Unable to open bundle %s: %s\n", bundle_path, errno == EINVAL ? "not a valid bundle" : strerror(errno));
+        else
+            printf("Unable to open current directory\n");
+        trace_stop();
+        free_event_loop(loop);
+        return 1;
+    }
+    const int catalog_event = event_loop_add_fd(loop, catalog_watch(catalog));
+
+    // the scores of a bundle go next to it, foo.vgc keeps them in foo.scores. The games we start inherit the path
+    if (bundle_path != NULL && getenv("VGC_SCORES") == NULL) {
+        char scores[512];
+        const char* ext = strrchr(bundle_path, '.');
+        const int stem = ext != NULL && strcmp(ext, ".vgc") == 0 ? (int) (ext - bundle_path) : (int) strlen(bundle_path);
+        snprintf(scores, sizeof(scores), "%.*s.scores", stem, bundle_path);
+        setenv("VGC_SCORES", scores, 1);
     }
+    scores_start(); // after the event loop, so the writer thread has the signals blocked too
 
+    perf_start("main-screen");
     init_ncurses();
+    renderer = create_renderer(COLS, LINES);
+    if (renderer == NULL) {
+        cleanup();
+        printf("Failed to allocate the screen buffers\n");
+        return 1;
+    }
 
-    main_screen = initialize_main_screen(game_names, num_of_games);
+    main_screen = initialize_main_screen(catalog);
+    if (main_screen == NULL) {
+        cleanup();
+        printf("Failed to allocate the menu\n");
+        return 1;
+    }
     print_whole_screen(main_screen);
+    input_init(&menu_input);
 
     int run = 1;
-    const int input_poll_ms = 20;
     while (run) {
+        LoopEvents events = event_loop_wait(loop); // no tick in the menu, this sleeps until a key or a signal
 
-        char ch = getch();
-        if (ch >= 'A' && ch <= 'Z')
-            ch += 32;
-        if (ch == 'q')
+        if (events.flags & EVENT_QUIT)
             run = 0;
-
-        if (ch == 'w' || ch == 's' || ch == 'a' || ch == 'd' || ch == '\n') {
-            handle_input(main_screen, ch);
+        if (events.flags & EVENT_RESIZE) {
+            renderer_resize_to_terminal(renderer);
+            select_match(main_screen, main_screen->current_match); // as many games as fit now, still showing the current one
+            print_whole_screen(main_screen);
         }
-
-        napms(input_poll_ms);
+        if ((events.flags & EVENT_SUSPEND) && !renderer_suspend(renderer))
+            run = 0; // in the menu it is the console that stops, like any program. Killed while it was stopped
+        if (events.flags & catalog_event)
+            refresh_catalog(main_screen);
+
+        if (events.flags & EVENT_INPUT) {
+            // enter can start a game, so the keys typed after it are left for the game to read
+            int entered = 1;
+            while (run && entered) {
+                entered = input_drain(&menu_input, '\n');
+                int keys[input_ring_capacity];
+                const int n = input_take_batch(&menu_input, keys, input_ring_capacity);
+                for (int i = 0; i < n && run; i++) {
+                    if (handle_input(main_screen, keys[i]) == GAME_QUIT)
+                        run = 0;
+                }
+                if (run && entered && handle_input(main_screen, '\n') == GAME_QUIT)
+                    run = 0;
+            }
+        }
+        renderer_flush(renderer); // a whole slide or button change goes out with a single refresh
+        perf_sample_heap_if_due();
     }
 
     cleanup();
@@ -0,0 +1,439 @@
+// runs thousands of headless snake and racing games with simple bots on every core, for bot evaluation and load tests
+// usage: vgc-batch [--game snake|racing|both] [--games N] [--ticks T] [--threads K] [--batch B] [--seed S]
+
+#define _GNU_SOURCE // sched_getcpu, pthread_setaffinity_np
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lib/arena.h"
+#include "../lib/clock.h"
+#include "../lib/racing_core.h"
+#include "../lib/snake_core.h"
+
+/*  The games are cut into chunks of --batch games. Each worker starts with an even share of the chunks as a range
+ *  [begin, end) packed into one atomic word: the owner takes chunks from the front, an idle worker steals the back half
+ *  of someone else's range, both with a single CAS on that word. A chunk's games are created together in the worker's
+ *  arena and ticked in lockstep, so the states the inner loop walks are contiguous and stay in the worker's cache.
+ *  Game i always gets seed + i, so the totals don't depend on which worker ran what.
+ */
+
+#define max_snake_score (default_board_width * default_board_height)
+#define survival_buckets 64
+
+typedef struct {
+    long games;
+    long ticks;
+    long chunks;
+    long steals;
+    long long busy_ns;
+
+    long snake_games;
+    long snake_wins;
+    long snake_stuck; // games that ended with the snake boxed in by its own tail
+    long snake_scores[max_snake_score + 1]; // final snake length
+
+    long racing_games;
+    long racing_crashes;
+    long racing_rows;          // track rows generated
+    long racing_repaired_rows; // of them, rows that walled off every lane and had an obstacle taken out
+    long racing_survived[survival_buckets]; // ticks before the crash, in buckets of ticks / survival_buckets
+} WorkerStats;
+
+typedef struct {
+    alignas(64) _Atomic uint64_t range; // chunk begin in the high half, end in the low half
+    alignas(64) WorkerStats stats; // only its own thread writes it, away from the range other workers CAS on
+    int id;
+    int cpu;
+    Arena* arena;
+    pthread_t thread;
+} Worker;
+
+typedef struct {
+    int snake;
+    int racing;
+    long games;
+    long ticks;
+    int threads;
+    int batch;
+    unsigned long seed;
+} BatchConfig;
+
+static BatchConfig config = {1, 1, 10000, 1000, 0, 64, 1};
+static Worker* workers;
+static atomic_int out_of_memory; // a chunk didn't fit its worker's arena, every worker stops and nothing is reported
+
+static uint64_t pack_range(const uint32_t begin, const uint32_t end) {
+    return (uint64_t) begin << 32 | end;
+}
+
+static int take_chunk(Worker* w, uint32_t* chunk) {
+    uint64_t range = atomic_load(&w->range);
+    for (;;) {
+        const uint32_t begin = range >> 32;
+        const uint32_t end = (uint32_t) range;
+        if (begin >= end)
+            return 0;
+        if (atomic_compare_exchange_weak(&w->range, &range, pack_range(begin + 1, end))) {
+            *chunk = begin;
+            return 1;
+        }
+    }
+}
+
+// moves the back half of a victim's chunks to the thief, returns 0 if nobody has anything left
+static int steal_chunks(Worker* thief) {
+    for (int i = 1; i < config.threads; i++) {
+        Worker* victim = &workers[(thief->id + i) % config.threads];
+        uint64_t range = atomic_load(&victim->range);
+        for (;;) {
+            const uint32_t begin = range >> 32;
+            const uint32_t end = (uint32_t) range;
+            if (begin >= end)
+                break;
+            const uint32_t half = (end - begin + 1) / 2;
+            if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(begin, end - half))) {
+                // our own range is empty, so no one else can be taking from it right now
+                atomic_store(&thief->range, pack_range(end - half, end));
+                thief->stats.steals++;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// ---- bots ----
+
+static const int dx[] = {0, 1, 0, -1}; // snake_up, snake_right, snake_down, snake_left
+static const int dy[] = {-1, 0, 1, 0};
+
+static int snake_cell_free(const Board* b, const int x, const int y) {
+    return x >= 0 && x < b->width && y >= 0 && y < b->height && board_cell(b, board_index(b, x, y)) != cell_tail
+           && board_cell(b, board_index(b, x, y)) != cell_head;
+}
+
+/*  the direction that gets closest to the bait, preferring cells that still have a way out after them.
+ *  -1 if every way is blocked: the snake never moves while blocked, so its tail never clears and it is stuck for good
+ */
+static int snake_bot_move(const Board* b) {
+    const int head = b->snake[b->snake_head_idx];
+    const int x = head % b->width;
+    const int y = head / b->width;
+    const int bait_x = b->bait_pos % b->width;
+    const int bait_y = b->bait_pos / b->width;
+
+    int best = -1;
+    int best_score = 1 << 30;
+    for (int d = 0; d < 4; d++) {
+        const int nx = x + dx[d];
+        const int ny = y + dy[d];
+        if (!snake_cell_free(b, nx, ny))
+            continue;
+
+        int exits = 0;
+        for (int e = 0; e < 4; e++)
+            exits += snake_cell_free(b, nx + dx[e], ny + dy[e]);
+        const int score = abs(nx - bait_x) + abs(ny - bait_y) + (exits == 0 ? 1000 : 0);
+        if (score < best_score) {
+            best = d;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// stays in the lane unless the next row is blocked there, then takes a free lane next to it
+static int racing_bot_move(const Road* road) {
+    static const int choices[] = {neutral, left, right};
+    for (int i = 0; i < 3; i++) {
+        const int x = road->car_x + choices[i];
+        if (x < 0 || x >= road->width)
+            continue;
+        if (!road_has_obstacle(road, x, road->car_y) && !road_has_obstacle(road, x, road->car_y - 1))
+            return choices[i];
+    }
+    return neutral;
+}
+
+// ---- chunks ----
+
+// the chunk_ functions return -1 if the chunk's games don't fit in the arena
+static int run_snake_chunk(Worker* w, const long first, const int count) {
+    Board** boards = arena_alloc(w->arena, sizeof(Board*) * count);
+    char* done = arena_alloc(w->arena, count);
+    if (boards == NULL || done == NULL)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        boards[i] = create_board_in(w->arena, default_board_width, default_board_height, config.seed + first + i);
+        if (boards[i] == NULL)
+            return -1;
+    }
+
+    int alive = count;
+    memset(done, 0, count);
+    for (long tick = 0; tick < config.ticks && alive > 0; tick++) {
+        for (int i = 0; i < count; i++) {
+            if (done[i])
+                continue;
+            const int direction = snake_bot_move(boards[i]);
+            const int events = snake_step(boards[i], direction);
+            w->stats.ticks++;
+            if (direction == -1 && (events & SNAKE_BLOCKED)) {
+                w->stats.snake_stuck++;
+                done[i] = 1;
+                alive--;
+            }
+            else if (events & SNAKE_WON) {
+                w->stats.snake_wins++;
+                done[i] = 1;
+                alive--;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        w->stats.snake_scores[boards[i]->snake_length]++;
+    w->stats.snake_games += count;
+    return 0;
+}
+
+static int run_racing_chunk(Worker* w, const long first, const int count) {
+    Road** roads = arena_alloc(w->arena, sizeof(Road*) * count);
+    long* survived = arena_alloc(w->arena, sizeof(long) * count);
+    if (roads == NULL || survived == NULL)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        roads[i] = create_road_in(w->arena, road_width_inner, road_height, config.seed + first + i);
+        if (roads[i] == NULL)
+            return -1;
+        survived[i] = config.ticks;
+    }
+
+    int alive = count;
+    for (long tick = 0; tick < config.ticks && alive > 0; tick++) {
+        for (int i = 0; i < count; i++) {
+            if (roads[i]->crashed)
+                continue;
+            const int events = racing_step(roads[i], racing_bot_move(roads[i]));
+            w->stats.ticks++;
+            if (events & RACING_COLLISION) {
+                survived[i] = tick;
+                alive--;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        int bucket = survived[i] * survival_buckets / (config.ticks + 1);
+        w->stats.racing_survived[bucket]++;
+        w->stats.racing_crashes += roads[i]->crashed;
+        w->stats.racing_rows += roads[i]->track.generator.next_chunk * track_chunk_rows;
+        w->stats.racing_repaired_rows += roads[i]->track.generator.repaired_rows;
+    }
+    w->stats.racing_games += count;
+    return 0;
+}
+
+static int run_chunk(Worker* w, const uint32_t chunk) {
+    const long first = (long) chunk * config.batch;
+    const int count = first + config.batch <= config.games ? config.batch : (int) (config.games - first);
+
+    // with both games, the chunks alternate between them
+    const int snake = config.snake && (!config.racing || chunk % 2 == 0);
+
+    arena_reset(w->arena);
+    const long long start = monotonic_ns();
+    const int result = snake ? run_snake_chunk(w, first, count) : run_racing_chunk(w, first, count);
+    w->stats.busy_ns += monotonic_ns() - start;
+    w->stats.games += count;
+    w->stats.chunks++;
+    return result;
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+
+    // pinned to one core when there are enough of them, so the per-core numbers mean what they say
+    if (config.threads <= sysconf(_SC_NPROCESSORS_ONLN)) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    w->cpu = sched_getcpu();
+
+    // the arena is created here, so its pages are first touched and placed by the thread that uses them
+    w->arena = create_arena((size_t) config.batch * 64 * 1024 + (1 << 20));
+    if (w->arena == NULL) {
+        atomic_store(&out_of_memory, 1);
+        return NULL;
+    }
+
+    uint32_t chunk;
+    while (!atomic_load_explicit(&out_of_memory, memory_order_relaxed)) {
+        if (take_chunk(w, &chunk)) {
+            if (run_chunk(w, chunk) == -1)
+                atomic_store(&out_of_memory, 1);
+        }
+        else if (!steal_chunks(w))
+            break;
+    }
+    free_arena(w->arena);
+    return NULL;
+}
+
+// ---- report ----
+
+static long percentile(const long* counts, const int n, const long total, const double p) {
+    long seen = 0;
+    for (int i = 0; i < n; i++) {
+        seen += counts[i];
+        if (seen > p * (total - 1))
+            return i;
+    }
+    return n - 1;
+}
+
+static void report(const double seconds) {
+    WorkerStats total;
+    memset(&total, 0, sizeof(total));
+
+    printf("%-6s %-4s %8s %8s %12s %12s %7s %6s\n", "worker", "cpu", "chunks", "games", "ticks", "ticks/s", "steals", "busy");
+    for (int i = 0; i < config.threads; i++) {
+        const WorkerStats* s = &workers[i].stats;
+        printf("%-6d %-4d %8ld %8ld %12ld %12.0f %7ld %5.0f%%\n", i, workers[i].cpu, s->chunks, s->games, s->ticks,
+               s->busy_ns > 0 ? s->ticks / (s->busy_ns / 1e9) : 0.0, s->steals, 100.0 * s->busy_ns / 1e9 / seconds);
+
+        total.games += s->games;
+        total.ticks += s->ticks;
+        total.steals += s->steals;
+        total.snake_games += s->snake_games;
+        total.snake_wins += s->snake_wins;
+        total.snake_stuck += s->snake_stuck;
+        for (int j = 0; j <= max_snake_score; j++)
+            total.snake_scores[j] += s->snake_scores[j];
+        total.racing_games += s->racing_games;
+        total.racing_crashes += s->racing_crashes;
+        total.racing_rows += s->racing_rows;
+        total.racing_repaired_rows += s->racing_repaired_rows;
+        for (int j = 0; j < survival_buckets; j++)
+            total.racing_survived[j] += s->racing_survived[j];
+    }
+
+    printf("total: %ld games, %ld ticks in %.3f s, %.0f ticks/s on %d threads, %ld steals\n", total.games, total.ticks,
+           seconds, seconds > 0 ? total.ticks / seconds : 0.0, config.threads, total.steals);
+
+    if (total.snake_games > 0) {
+        double mean = 0;
+        for (int j = 0; j <= max_snake_score; j++)
+            mean += (double) j * total.snake_scores[j];
+        mean /= total.snake_games;
+        printf("snake: %ld games, length mean %.1f p10 %ld p50 %ld p90 %ld max %ld, %.2f%% won, %.2f%% got stuck\n",
+               total.snake_games, mean,
+               percentile(total.snake_scores, max_snake_score + 1, total.snake_games, 0.10),
+               percentile(total.snake_scores, max_snake_score + 1, total.snake_games, 0.50),
+               percentile(total.snake_scores, max_snake_score + 1, total.snake_games, 0.90),
+               percentile(total.snake_scores, max_snake_score + 1, total.snake_games, 1.0),
+               100.0 * total.snake_wins / total.snake_games,
+               100.0 * total.snake_stuck / total.snake_games);
+    }
+    if (total.racing_games > 0) {
+        const double bucket_ticks = (config.ticks + 1.0) / survival_buckets;
+        printf("racing: %ld games, %.2f%% crashed, ticks survived p10 ~%.0f p50 ~%.0f p90 ~%.0f\n", total.racing_games,
+               100.0 * total.racing_crashes / total.racing_games,
+               percentile(total.racing_survived, survival_buckets, total.racing_games, 0.10) * bucket_ticks,
+               percentile(total.racing_survived, survival_buckets, total.racing_games, 0.50) * bucket_ticks,
+               percentile(total.racing_survived, survival_buckets, total.racing_games, 0.90) * bucket_ticks);
+        printf("racing: %ld track rows, %.3f%% had obstacles taken out so every car keeps a move\n", total.racing_rows,
+               total.racing_rows > 0 ? 100.0 * total.racing_repaired_rows / total.racing_rows : 0.0);
+    }
+}
+
+static int parse_args(const int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            fprintf(stderr, "vgc-batch: %s needs a value\n", argv[i]);
+            return -1;
+        }
+        if (strcmp(argv[i], "--game") == 0) {
+            config.snake = strcmp(value, "snake") == 0 || strcmp(value, "both") == 0;
+            config.racing = strcmp(value, "racing") == 0 || strcmp(value, "both") == 0;
+            if (!config.snake && !config.racing) {
+                fprintf(stderr, "vgc-batch: unknown game %s\n", value);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--games") == 0)
+            config.games = strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--ticks") == 0)
+            config.ticks = strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--threads") == 0)
+            config.threads = (int) strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--batch") == 0)
+            config.batch = (int) strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0)
+            config.seed = strtoul(value, NULL, 0);
+        else {
+            fprintf(stderr, "usage: vgc-batch [--game snake|racing|both] [--games N] [--ticks T] [--threads K] "
+                            "[--batch B] [--seed S]\n");
+            return -1;
+        }
+        i++;
+    }
+    if (config.threads <= 0)
+        config.threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (config.games <= 0 || config.ticks <= 0 || config.batch <= 0 || config.threads <= 0) {
+        fprintf(stderr, "vgc-batch: --games, --ticks, --threads and --batch have to be positive\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (parse_args(argc, argv) == -1)
+        return 2;
+
+    const long num_chunks = (config.games + config.batch - 1) / config.batch;
+    if (num_chunks > UINT32_MAX) {
+        fprintf(stderr, "vgc-batch: too many chunks, raise --batch\n");
+        return 2;
+    }
+
+    workers = aligned_alloc(64, sizeof(Worker) * config.threads);
+    if (workers == NULL) {
+        fprintf(stderr, "vgc-batch: can't allocate %d workers: %s\n", config.threads, strerror(errno));
+        return 1;
+    }
+    memset(workers, 0, sizeof(Worker) * config.threads);
+    for (int i = 0; i < config.threads; i++) {
+        workers[i].id = i;
+        const uint32_t begin = num_chunks * i / config.threads;
+        const uint32_t end = num_chunks * (i + 1) / config.threads;
+        atomic_init(&workers[i].range, pack_range(begin, end));
+    }
+
+    const long long start = monotonic_ns();
+    for (int i = 0; i < config.threads; i++)
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    for (int i = 0; i < config.threads; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    if (atomic_load(&out_of_memory)) {
+        fprintf(stderr, "vgc-batch: a worker ran out of memory for a chunk of %d games, try a smaller --batch\n",
+                config.batch);
+        free(workers);
+        return 1;
+    }
+    report((monotonic_ns() - start) / 1e9);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,498 @@
+// runs every game and the console under a pseudo-terminal, types a fixed script of keys into each and measures what
+// comes back: key to output latency, bytes per frame, tick rate, start-up time and peak RSS, written out as JSON
+// usage: vgc-bench [--dir <bin dir>] [--out <file>] [--runs N] [--only <binary>] [--raw]
+//        vgc-bench --compare <old.json> <new.json> [--threshold <percent>]   exits with 1 if anything got worse
+
+#define _GNU_SOURCE // ppoll, posix_openpt and friends
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../lib/clock.h"
+
+/*  Every binary is measured the way a player sees it, from the terminal side only:
+ *
+ *      fork ... first byte ... end of first frame | warmup | key, key, ... every ~key_interval_ms | q ... exit
+ *      \_ startup_ms _/                          |        \_ latency: key written to the next byte read _/
+ *      \_______ first_frame_ms _______/
+ *
+ *  Output that arrives within frame_gap_ns of the previous read belongs to the same frame, which is how frames and
+ *  bytes per frame are counted while the keys are typed. A game that ticks redraws on its own, so its latency is the
+ *  time to the next frame that could show the key, the same wait a player has.
+ *  The games run with VGC_STATS=1 and print their tick stats when they leave, which gives the achieved tick rate next
+ *  to the configured one. Peak RSS is the child's ru_maxrss. Scores and perf counters are off, nothing is left behind.
+ *  The keys go out on an absolute schedule with a fixed jitter sequence, so every run types exactly the same thing
+ *  at the same times and the keys don't lock onto the tick phase.
+ */
+
+#define bench_cols 80
+#define bench_rows 24
+#define warmup_ms 300
+#define num_keys 40
+#define key_interval_ms 60
+#define key_jitter_ms 23
+#define frame_gap_ns 2000000ll
+#define start_timeout_ms 5000
+#define exit_timeout_ms 3000
+#define max_runs 16
+#define tail_size 65536 // what the game prints after q, the stats are in there
+
+typedef struct {
+    const char* binary;
+    const char* keys; // typed in a loop, q is sent after the last one
+} BenchTarget;
+
+static const BenchTarget targets[] = {
+    {"game_snake", "wdsa"},     // around in a square, so it keeps going without hitting a wall
+    {"game_racing", "adda"},
+    {"game_blackjack", "nhs"},  // next hand, hit, stand
+    {"main-screen", "sssw"},    // moving through the menu, nothing is started
+};
+#define num_targets ((int) (sizeof(targets) / sizeof(targets[0])))
+
+typedef struct {
+    double startup_ms;
+    double first_frame_ms;
+    double latencies_ms[num_keys];
+    int num_latencies;
+    int silent_keys; // nothing came back before the next key
+    long bytes;      // while the keys were typed
+    long frames;
+    double seconds;
+    double tick_rate; // from the game's own stats, 0 if it printed none
+    double configured_rate;
+    long peak_rss_kb;
+    int exit_status;
+} RunResult;
+
+static const char* bin_dir = ".";
+static const char* out_path;
+static int runs = 3;
+static const char* only;
+static int raw_output;
+
+// the child end of a new pty becomes its controlling terminal, with a fixed size so every run draws the same
+static pid_t spawn_on_pty(const char* binary, int* master_fd) {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+        if (master != -1)
+            close(master);
+        return -1;
+    }
+    char slave_name[128];
+    if (ptsname_r(master, slave_name, sizeof(slave_name)) != 0) {
+        close(master);
+        return -1;
+    }
+
+    const pid_t pid = fork();
+    if (pid == -1) {
+        close(master);
+        return -1;
+    }
+    if (pid == 0) {
+        setsid();
+        const int slave = open(slave_name, O_RDWR);
+        if (slave == -1)
+            _exit(127);
+        ioctl(slave, TIOCSCTTY, 0);
+        const struct winsize size = {.ws_row = bench_rows, .ws_col = bench_cols};
+        ioctl(slave, TIOCSWINSZ, &size);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO)
+            close(slave);
+
+        setenv("TERM", "xterm", 1);
+        setenv("VGC_STATS", "1", 1);
+        setenv("VGC_SCORES", "0", 1);
+        setenv("VGC_PERF", "0", 1);
+        unsetenv("VGC_SPECTATE");
+        unsetenv("VGC_SNAKE_BOARD");
+        if (raw_output)
+            setenv("VGC_OUTPUT", "raw", 1);
+        else
+            unsetenv("VGC_OUTPUT");
+
+        char path[512];
+        snprintf(path, sizeof(path), "./%s", binary);
+        if (chdir(bin_dir) == 0)
+            execl(path, binary, (char*) NULL);
+        _exit(127);
+    }
+    *master_fd = master;
+    return pid;
+}
+
+// the gap before key i, the same sequence in every run
+static long long key_gap_ns(const int i) {
+    const unsigned int jitter = (i * 2654435761u) >> 16;
+    return (key_interval_ms + jitter % key_jitter_ms) * 1000000ll;
+}
+
+enum phase { STARTING, WARMUP, TYPING, LEAVING };
+
+static int run_target(const BenchTarget* target, RunResult* result) {
+    memset(result, 0, sizeof(RunResult));
+    const long long started = monotonic_ns();
+    int master;
+    const pid_t pid = spawn_on_pty(target->binary, &master);
+    if (pid == -1)
+        return -1;
+
+    static char tail[tail_size];
+    size_t tail_used = 0;
+    char buffer[65536];
+    enum phase phase = STARTING;
+    long long first_byte = 0, last_read = 0, next_key = 0, key_sent = 0, typing_started = 0, left = 0;
+    int keys_typed = 0;
+
+    while (1) {
+        long long deadline;
+        if (phase == STARTING)
+            deadline = first_byte == 0 ? started + start_timeout_ms * 1000000ll : last_read + frame_gap_ns;
+        else if (phase == LEAVING)
+            deadline = left + exit_timeout_ms * 1000000ll;
+        else
+            deadline = next_key;
+
+        const long long now = monotonic_ns();
+        const long long wait = deadline > now ? deadline - now : 0;
+        const struct timespec timeout = {.tv_sec = wait / 1000000000ll, .tv_nsec = wait % 1000000000ll};
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        const int ready = ppoll(&pfd, 1, &timeout, NULL);
+        if (ready == -1 && errno != EINTR)
+            break;
+
+        if (ready > 0) {
+            const ssize_t n = read(master, buffer, sizeof(buffer));
+            const long long at = monotonic_ns();
+            if (n <= 0)
+                break; // EIO once the game has exited and closed its end
+            if (first_byte == 0)
+                first_byte = at;
+            if (phase == TYPING) {
+                result->bytes += n;
+                if (at - last_read > frame_gap_ns)
+                    result->frames++;
+                if (key_sent != 0) {
+                    result->latencies_ms[result->num_latencies++] = (at - key_sent) / 1e6;
+                    key_sent = 0;
+                }
+            }
+            if (phase == LEAVING && tail_used < sizeof(tail) - 1) {
+                const size_t take = (size_t) n < sizeof(tail) - 1 - tail_used ? (size_t) n : sizeof(tail) - 1 - tail_used;
+                memcpy(tail + tail_used, buffer, take);
+                tail_used += take;
+            }
+            last_read = at;
+            continue;
+        }
+        if (monotonic_ns() < deadline)
+            continue;
+
+        // the deadline of the current phase passed
+        if (phase == STARTING) {
+            if (first_byte == 0)
+                break; // never drew anything
+            result->startup_ms = (first_byte - started) / 1e6;
+            result->first_frame_ms = (last_read - started) / 1e6;
+            phase = WARMUP;
+            next_key = last_read + warmup_ms * 1000000ll;
+        }
+        else if (phase == WARMUP || phase == TYPING) {
+            if (phase == WARMUP) {
+                phase = TYPING;
+                typing_started = next_key;
+            }
+            if (key_sent != 0)
+                result->silent_keys++;
+            const char key = keys_typed < num_keys ? target->keys[keys_typed % strlen(target->keys)] : 'q';
+            key_sent = monotonic_ns(); // before the write, the game can answer before write() returns to us
+            if (write(master, &key, 1) != 1)
+                break;
+            if (keys_typed++ == num_keys) {
+                result->seconds = (key_sent - typing_started) / 1e9;
+                key_sent = 0;
+                phase = LEAVING;
+                left = monotonic_ns();
+            }
+            else
+                next_key += key_gap_ns(keys_typed);
+        }
+        else
+            break; // it didn't leave on q
+    }
+
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    if (wait4(pid, &status, WNOHANG, &usage) == 0) {
+        kill(pid, SIGKILL);
+        while (wait4(pid, &status, 0, &usage) == -1 && errno == EINTR) {}
+    }
+    close(master);
+
+    result->peak_rss_kb = usage.ru_maxrss;
+    result->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    tail[tail_used] = '\0';
+    const char* ticks = strstr(tail, " ticks in ");
+    double seconds;
+    if (ticks != NULL)
+        sscanf(ticks, " ticks in %lfs (%lf/s, configured %lf/s)", &seconds, &result->tick_rate,
+               &result->configured_rate);
+    return phase == LEAVING && result->exit_status == 0 ? 0 : -1;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    const double x = *(const double*) a;
+    const double y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank, sorted has to be sorted
+static double percentile(const double* sorted, const int n, const double p) {
+    if (n == 0)
+        return 0;
+    int rank = (int) (p * n);
+    if (rank == p * n)
+        rank--;
+    return sorted[rank < 0 ? 0 : rank];
+}
+
+static double median(double* values, const int n) {
+    qsort(values, n, sizeof(double), compare_doubles);
+    return percentile(values, n, 0.5);
+}
+
+static void write_metrics(FILE* out, const BenchTarget* target, RunResult* results, const int n, const int last) {
+    double latencies[num_keys * max_runs];
+    double startup[max_runs], first_frame[max_runs], rss[max_runs];
+    int num_latencies = 0, silent_keys = 0;
+    long bytes = 0, frames = 0;
+    double seconds = 0, tick_rate = 0, configured_rate = 0;
+    int tick_runs = 0;
+    for (int r = 0; r < n; r++) {
+        memcpy(latencies + num_latencies, results[r].latencies_ms, results[r].num_latencies * sizeof(double));
+        num_latencies += results[r].num_latencies;
+        silent_keys += results[r].silent_keys;
+        startup[r] = results[r].startup_ms;
+        first_frame[r] = results[r].first_frame_ms;
+        rss[r] = results[r].peak_rss_kb;
+        bytes += results[r].bytes;
+        frames += results[r].frames;
+        seconds += results[r].seconds;
+        if (results[r].configured_rate > 0) {
+            tick_rate += results[r].tick_rate;
+            configured_rate = results[r].configured_rate;
+            tick_runs++;
+        }
+    }
+    qsort(latencies, num_latencies, sizeof(double), compare_doubles);
+
+    const char* name = target->binary;
+    fprintf(out, "  \"%s.startup_ms\": %.3f,\n", name, median(startup, n));
+    fprintf(out, "  \"%s.first_frame_ms\": %.3f,\n", name, median(first_frame, n));
+    fprintf(out, "  \"%s.latency_p50_ms\": %.3f,\n", name, percentile(latencies, num_latencies, 0.50));
+    fprintf(out, "  \"%s.latency_p90_ms\": %.3f,\n", name, percentile(latencies, num_latencies, 0.90));
+    fprintf(out, "  \"%s.latency_p99_ms\": %.3f,\n", name, percentile(latencies, num_latencies, 0.99));
+    fprintf(out, "  \"%s.latency_max_ms\": %.3f,\n", name, num_latencies > 0 ? latencies[num_latencies - 1] : 0.0);
+    fprintf(out, "  \"%s.silent_keys\": %d,\n", name, silent_keys);
+    fprintf(out, "  \"%s.frames_per_s\": %.2f,\n", name, seconds > 0 ? frames / seconds : 0.0);
+    fprintf(out, "  \"%s.bytes_per_frame\": %.1f,\n", name, frames > 0 ? (double) bytes / frames : 0.0);
+    if (tick_runs > 0) {
+        fprintf(out, "  \"%s.tick_rate\": %.2f,\n", name, tick_rate / tick_runs);
+        fprintf(out, "  \"%s.configured_tick_rate\": %.2f,\n", name, configured_rate);
+    }
+    fprintf(out, "  \"%s.peak_rss_kb\": %.0f%s\n", name, median(rss, n), last ? "" : ",");
+}
+
+static int bench(void) {
+    FILE* out = stdout;
+    if (out_path != NULL && (out = fopen(out_path, "w")) == NULL) {
+        fprintf(stderr, "vgc-bench: can't write %s: %s\n", out_path, strerror(errno));
+        return 2;
+    }
+
+    int chosen[num_targets];
+    int num_chosen = 0;
+    for (int t = 0; t < num_targets; t++) {
+        if (only == NULL || strcmp(only, targets[t].binary) == 0)
+            chosen[num_chosen++] = t;
+    }
+    if (num_chosen == 0) {
+        fprintf(stderr, "vgc-bench: no binary called %s\n", only);
+        return 2;
+    }
+
+    fprintf(out, "{\n  \"vgc_bench\": 1,\n  \"runs\": %d,\n  \"raw_output\": %d,\n", runs, raw_output);
+    int failed = 0;
+    for (int c = 0; c < num_chosen; c++) {
+        const BenchTarget* target = &targets[chosen[c]];
+        RunResult results[max_runs];
+        int n = 0;
+        for (int r = 0; r < runs; r++) {
+            if (run_target(target, &results[n]) == 0)
+                n++;
+            else
+                fprintf(stderr, "vgc-bench: %s run %d failed, exit status %d\n", target->binary, r + 1,
+                        results[n].exit_status);
+        }
+        fprintf(stderr, "vgc-bench: %s, %d of %d runs\n", target->binary, n, runs);
+        if (n == 0) {
+            failed = 1;
+            fprintf(out, "  \"%s.failed\": 1%s\n", target->binary, c == num_chosen - 1 ? "" : ",");
+            continue;
+        }
+        write_metrics(out, target, results, n, c == num_chosen - 1);
+    }
+    fprintf(out, "}\n");
+    if (out != stdout)
+        fclose(out);
+    return failed;
+}
+
+#define max_metrics 256
+
+typedef struct {
+    char name[96];
+    double value;
+} Metric;
+
+// the "name": value lines bench() writes, one per line, nothing else of JSON is needed to read them back
+static int read_metrics(const char* path, Metric* metrics) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "vgc-bench: can't read %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int n = 0;
+    while (n < max_metrics && fgets(line, sizeof(line), in) != NULL) {
+        if (sscanf(line, " \"%95[^\"]\": %lf", metrics[n].name, &metrics[n].value) == 2)
+            n++;
+    }
+    fclose(in);
+    return n;
+}
+
+typedef struct {
+    const char* suffix;
+    int lower_is_better; // -1 where higher is better. Metrics without a rule are only reported, not compared
+    double noise; // changes smaller than this never count, whatever the percentage
+} MetricRule;
+
+static const MetricRule rules[] = {
+    {".startup_ms", 1, 1.0},
+    {".first_frame_ms", 1, 1.0},
+    {".latency_p50_ms", 1, 1.0},
+    {".latency_p90_ms", 1, 2.0},
+    {".latency_p99_ms", 1, 5.0},
+    {".bytes_per_frame", 1, 4.0},
+    {".peak_rss_kb", 1, 512.0},
+    {".tick_rate", -1, 0.2},
+};
+
+static const MetricRule* rule_for(const char* name) {
+    const size_t length = strlen(name);
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        const size_t suffix = strlen(rules[i].suffix);
+        if (length > suffix && strcmp(name + length - suffix, rules[i].suffix) == 0)
+            return &rules[i];
+    }
+    return NULL;
+}
+
+static int compare(const char* old_path, const char* new_path, const double threshold) {
+    static Metric old[max_metrics], new[max_metrics];
+    const int num_old = read_metrics(old_path, old);
+    const int num_new = read_metrics(new_path, new);
+    if (num_old == -1 || num_new == -1)
+        return 2;
+
+    int regressions = 0;
+    printf("%-36s %12s %12s %9s\n", "metric", "old", "new", "change");
+    for (int i = 0; i < num_new; i++) {
+        const MetricRule* rule = rule_for(new[i].name);
+        const Metric* before = NULL;
+        for (int j = 0; j < num_old && before == NULL; j++) {
+            if (strcmp(old[j].name, new[i].name) == 0)
+                before = &old[j];
+        }
+        if (rule == NULL || before == NULL)
+            continue;
+
+        const double delta = new[i].value - before->value;
+        const double base = before->value < 0 ? -before->value : before->value;
+        const double percent = base != 0 ? 100.0 * delta / base : 0;
+        const double worse = rule->lower_is_better > 0 ? delta : -delta;
+        const char* verdict = "";
+        if (worse > rule->noise && (base == 0 || 100.0 * worse / base > threshold)) {
+            verdict = "  REGRESSION";
+            regressions++;
+        }
+        else if (-worse > rule->noise && base != 0 && 100.0 * -worse / base > threshold)
+            verdict = "  better";
+        printf("%-36s %12.3f %12.3f %+8.1f%%%s\n", new[i].name, before->value, new[i].value, percent, verdict);
+    }
+    printf("%d regression%s over %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    return regressions > 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: vgc-bench [--dir <bin dir>] [--out <file>] [--runs N] [--only <binary>] [--raw]\n"
+                    "       vgc-bench --compare <old.json> <new.json> [--threshold <percent>]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && strcmp(argv[1], "--compare") == 0) {
+        double threshold = 10;
+        if (argc == 6 && strcmp(argv[4], "--threshold") == 0)
+            threshold = strtod(argv[5], NULL);
+        else if (argc != 4) {
+            usage();
+            return 2;
+        }
+        return compare(argv[2], argv[3], threshold);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--raw") == 0) {
+            raw_output = 1;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--dir") == 0)
+            bin_dir = value;
+        else if (strcmp(argv[i], "--out") == 0)
+            out_path = value;
+        else if (strcmp(argv[i], "--runs") == 0)
+            runs = (int) strtol(value, NULL, 0);
+        else if (strcmp(argv[i], "--only") == 0)
+            only = value;
+        else {
+            usage();
+            return 2;
+        }
+        i++;
+    }
+    if (runs < 1 || runs > max_runs) {
+        fprintf(stderr, "vgc-bench: --runs has to be 1 to %d\n", max_runs);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    return bench();
+}
@@ -0,0 +1,222 @@
+// joins a vgc-server game in this terminal: a and d steer, r gets back on the road after a crash, q leaves
+// usage: vgc-client [--socket <path>]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ncurses.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../lib/clock.h"
+#include "../lib/event_loop.h"
+#include "../lib/input.h"
+#include "../lib/multiplayer.h"
+#include "../lib/render.h"
+
+static int server_fd = -1;
+static WelcomeMsg welcome;
+static unsigned char* frame;
+static uint32_t input_seq;
+
+// what came in, for the status line and VGC_STATS
+static long frames;
+static long keyframes;
+static long long bytes;
+static uint32_t last_tick;
+static int players;
+static InputQueue input;
+static int have_keyframe; // deltas before the first keyframe have nothing to apply to
+
+static int connect_to_server(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// blocking, before the terminal is set up, so errors can simply be printed
+static int join(void) {
+    const HelloMsg hello = {MSG_HELLO, mp_version};
+    if (send(server_fd, &hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello))
+        return -1;
+    const ssize_t n = recv(server_fd, &welcome, sizeof(welcome), 0);
+    if (n == 1 && welcome.type == MSG_FULL) {
+        printf("The game is full, %d players already\n", mp_max_players);
+        return -1;
+    }
+    if (n == sizeof(HelloMsg) && welcome.type == MSG_VERSION) {
+        printf("The server speaks protocol version %d, this client %d\n", ((const HelloMsg*) &welcome)->version,
+               mp_version);
+        return -1;
+    }
+    if (n != sizeof(welcome) || welcome.type != MSG_WELCOME) {
+        printf("The server didn't let us in\n");
+        return -1;
+    }
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+static void send_input(const int direction, const int respawn) {
+    const InputMsg input = {MSG_INPUT, (int8_t) direction, (uint8_t) respawn, 0, ++input_seq, monotonic_ns()};
+    send(server_fd, &input, sizeof(input), MSG_DONTWAIT | MSG_NOSIGNAL); // a full socket loses the key, like a dropped frame
+}
+
+static void draw_borders(Renderer* renderer) {
+    for (int y = 0; y < welcome.height; y++) {
+        renderer_put(renderer, 0, y, '|');
+        renderer_put(renderer, welcome.width + 1, y, '|');
+    }
+}
+
+static void apply_frame(Renderer* renderer, const size_t size) {
+    const FrameHeader* header = (const FrameHeader*) frame;
+    if (size < sizeof(FrameHeader) || size != sizeof(FrameHeader) + sizeof(WireCell) * header->count)
+        return;
+    if (header->type == MSG_KEYFRAME)
+        have_keyframe = 1;
+    else if (header->type != MSG_DELTA || !have_keyframe)
+        return;
+
+    const WireCell* cells = (const WireCell*) (frame + sizeof(FrameHeader));
+    for (int i = 0; i < header->count; i++) {
+        if (cells[i].x < welcome.width && cells[i].y < welcome.height)
+            renderer_put(renderer, cells[i].x + 1, cells[i].y, cells[i].c); // +1 to skip the left border
+    }
+    frames++;
+    keyframes += header->type == MSG_KEYFRAME;
+    last_tick = header->tick;
+    players = header->players;
+}
+
+// returns 0 once the server is gone
+static int read_frames(Renderer* renderer) {
+    for (;;) {
+        const ssize_t n = recv(server_fd, frame, mp_max_frame(welcome.width, welcome.height), MSG_DONTWAIT);
+        if (n == -1 && (errno == EAGAIN || errno == EINTR))
+            return 1;
+        if (n <= 0)
+            return 0;
+        bytes += n;
+        apply_frame(renderer, n);
+    }
+}
+
+int main(int argc, char** argv) {
+    char socket_path[108];
+    mp_default_socket(socket_path, sizeof(socket_path));
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--socket") == 0)
+            snprintf(socket_path, sizeof(socket_path), "%s", argv[i + 1]);
+    }
+
+    server_fd = connect_to_server(socket_path);
+    if (server_fd == -1) {
+        printf("No game at %s (%s), start one with vgc-server\n", socket_path, strerror(errno));
+        return 1;
+    }
+    if (join() == -1) {
+        close(server_fd);
+        return 1;
+    }
+    frame = malloc(mp_max_frame(welcome.width, welcome.height));
+    if (frame == NULL) {
+        printf("Failed to allocate the frame buffer\n");
+        close(server_fd);
+        return 1;
+    }
+
+    EventLoop* loop = create_event_loop();
+    if (loop == NULL) {
+        printf("Failed to set up the event loop\n");
+        return 1;
+    }
+    const int server_event = event_loop_add_fd(loop, server_fd);
+
+    init_terminal();
+    Renderer* renderer = create_renderer(COLS, LINES);
+    if (renderer == NULL) {
+        endwin();
+        printf("Failed to allocate the screen buffers\n");
+        free_event_loop(loop);
+        free(frame);
+        close(server_fd);
+        return 1;
+    }
+    draw_borders(renderer);
+    renderer_flush(renderer);
+
+    input_init(&input);
+    const long long start = monotonic_ns();
+    int server_gone = 0;
+    int run = 1;
+    while (run) {
+        LoopEvents events = event_loop_wait(loop);
+
+        if (events.flags & EVENT_QUIT)
+            run = 0;
+        if (events.flags & EVENT_RESIZE)
+            renderer_resize_to_terminal(renderer);
+
+        if (events.flags & EVENT_INPUT) {
+            if (input_drain(&input, 'q'))
+                run = 0;
+            // the server steers once per tick, so of a burst only the last direction is worth a message
+            int keys[input_ring_capacity];
+            const int n = input_take_batch(&input, keys, input_ring_capacity);
+            int steer = 0;
+            for (int i = 0; i < n; i++) {
+                if (keys[i] == 'a' || keys[i] == KEY_LEFT)
+                    steer = -1;
+                else if (keys[i] == 'd' || keys[i] == KEY_RIGHT)
+                    steer = 1;
+                else if (keys[i] == 'r')
+                    send_input(0, 1);
+            }
+            if (steer != 0)
+                send_input(steer, 0);
+        }
+
+        if ((events.flags & server_event) && !read_frames(renderer)) {
+            server_gone = 1;
+            run = 0;
+        }
+
+        const double seconds = (monotonic_ns() - start) / 1e9;
+        renderer_print(renderer, 0, welcome.height, "player %d of %d  tick %u  %.0f B/s   ", welcome.player + 1,
+                       players, last_tick, seconds > 0 ? bytes / seconds : 0.0);
+        renderer_flush(renderer); // one frame for everything that came in since the last wakeup
+    }
+
+    clear();
+    endwin();
+    system("clear");
+    if (server_gone)
+        printf("The server ended the game\n");
+
+    if (getenv("VGC_STATS") != NULL) {
+        const double seconds = (monotonic_ns() - start) / 1e9;
+        fprintf(stderr, "vgc-client: %ld frames (%ld keyframes), %lld bytes in %.1f s (%.0f B/s), %u inputs sent\n",
+                frames, keyframes, bytes, seconds, seconds > 0 ? bytes / seconds : 0.0, input_seq);
+    }
+    renderer_report_stats(renderer, "vgc-client", stderr);
+    input_report_stats(&input, "vgc-client", stderr);
+    free_renderer(renderer);
+    free_event_loop(loop);
+    free(frame);
+    close(server_fd);
+    return 0;
+}
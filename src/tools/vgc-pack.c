@@ -0,0 +1,176 @@
+// packs games into a bundle the console runs with --bundle, see lib/bundle.h for the format
+// usage: vgc-pack <bundle> <game>...     pack the files, the bundle is replaced atomically
+//        vgc-pack -t <bundle>            list a bundle and verify every checksum
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../lib/bundle.h"
+#include "../lib/clock.h"
+
+typedef struct {
+    const char* path;
+    const void* data; // the file, mapped
+    BundleEntry entry;
+} PackFile;
+
+static int compare_files(const void* a, const void* b) {
+    return strcmp(((const PackFile*) a)->entry.name, ((const PackFile*) b)->entry.name);
+}
+
+static uint64_t align_up(const uint64_t n) {
+    return (n + bundle_align - 1) / bundle_align * bundle_align;
+}
+
+static int write_at(const int fd, const void* data, size_t size, off_t offset) {
+    const char* p = data;
+    while (size > 0) {
+        const ssize_t n = pwrite(fd, p, size, offset);
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int map_file(PackFile* file) {
+    const int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "vgc-pack: %s: %s\n", file->path, fd == -1 ? strerror(errno) : "not a regular file");
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+
+    const char* name = strrchr(file->path, '/');
+    name = name == NULL ? file->path : name + 1;
+    if (strlen(name) >= bundle_name_size) {
+        fprintf(stderr, "vgc-pack: %s: name longer than %d characters\n", file->path, bundle_name_size - 1);
+        close(fd);
+        return -1;
+    }
+
+    memset(&file->entry, 0, sizeof(BundleEntry));
+    snprintf(file->entry.name, sizeof(file->entry.name), "%s", name);
+    file->entry.size = st.st_size;
+    file->entry.mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+
+    file->data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (file->data == MAP_FAILED) {
+        fprintf(stderr, "vgc-pack: %s: %s\n", file->path, strerror(errno));
+        return -1;
+    }
+    file->entry.checksum = bundle_checksum(file->data, st.st_size);
+    return 0;
+}
+
+static int pack(const char* bundle_path, char** paths, const int count) {
+    const long long start = monotonic_ns();
+
+    PackFile* files = calloc(count > 0 ? count : 1, sizeof(PackFile));
+    if (files == NULL) {
+        fprintf(stderr, "vgc-pack: can't allocate the list of %d games: %s\n", count, strerror(errno));
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        files[i].path = paths[i];
+        if (map_file(&files[i]) == -1)
+            return 1;
+    }
+    qsort(files, count, sizeof(PackFile), compare_files);
+
+    BundleEntry* table = calloc(count > 0 ? count : 1, sizeof(BundleEntry));
+    if (table == NULL) {
+        fprintf(stderr, "vgc-pack: can't allocate the table of %d games: %s\n", count, strerror(errno));
+        return 1;
+    }
+    uint64_t offset = align_up(sizeof(BundleHeader) + sizeof(BundleEntry) * count);
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && strcmp(files[i - 1].entry.name, files[i].entry.name) == 0) {
+            fprintf(stderr, "vgc-pack: %s is given twice\n", files[i].entry.name);
+            return 1;
+        }
+        files[i].entry.offset = offset;
+        table[i] = files[i].entry;
+        offset = align_up(offset + files[i].entry.size);
+    }
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, bundle_magic, sizeof(header.magic));
+    header.version = bundle_version;
+    header.count = count;
+    header.table_checksum = bundle_checksum(table, sizeof(BundleEntry) * count);
+
+    // written next to the old bundle and renamed over it, a console that has the old one mapped keeps working
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", bundle_path);
+    const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "vgc-pack: %s: %s\n", tmp_path, strerror(errno));
+        return 1;
+    }
+
+    // the padding between the games is a hole, ftruncate sizes the file and the gaps read as zeros
+    int failed = ftruncate(fd, (off_t) offset) == -1
+                 || write_at(fd, &header, sizeof(header), 0) == -1
+                 || write_at(fd, table, sizeof(BundleEntry) * count, sizeof(header)) == -1;
+    for (int i = 0; i < count && !failed; i++)
+        failed = write_at(fd, files[i].data, files[i].entry.size, (off_t) files[i].entry.offset) == -1;
+    failed = close(fd) == -1 || failed;
+
+    if (failed || rename(tmp_path, bundle_path) == -1) {
+        fprintf(stderr, "vgc-pack: could not write %s: %s\n", bundle_path, strerror(errno));
+        unlink(tmp_path);
+        return 1;
+    }
+
+    printf("packed %d games into %s, %llu bytes in %.2f ms\n", count, bundle_path, (unsigned long long) offset,
+           (monotonic_ns() - start) / 1e6);
+    for (int i = 0; i < count; i++) {
+        if (files[i].data != NULL)
+            munmap((void*) files[i].data, files[i].entry.size);
+    }
+    free(files);
+    free(table);
+    return 0;
+}
+
+static int list(const char* bundle_path) {
+    Bundle* bundle = open_bundle(bundle_path);
+    if (bundle == NULL) {
+        fprintf(stderr, "vgc-pack: %s: %s\n", bundle_path, errno == EINVAL ? "not a valid bundle" : strerror(errno));
+        return 1;
+    }
+
+    int bad = 0;
+    for (uint32_t i = 0; i < bundle->header->count; i++) {
+        const BundleEntry* entry = &bundle->entries[i];
+        const int ok = bundle_checksum(bundle->data + entry->offset, entry->size) == entry->checksum;
+        printf("%-40s %10llu bytes at %10llu  %s\n", entry->name, (unsigned long long) entry->size,
+               (unsigned long long) entry->offset, ok ? "ok" : "CHECKSUM MISMATCH");
+        bad += !ok;
+    }
+    free_bundle(bundle);
+    return bad > 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "-t") == 0)
+        return list(argv[2]);
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: vgc-pack <bundle> <game>...\n       vgc-pack -t <bundle>\n");
+        return 2;
+    }
+    return pack(argv[1], argv + 2, argc - 2);
+}
@@ -0,0 +1,412 @@
+// multiplayer racing server: one road, up to 8 cars, every player in their own terminal with vgc-client
+// usage: vgc-server [--socket <path>] [--seed <n>]
+
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../lib/clock.h"
+#include "../lib/event_loop.h"
+#include "../lib/multiplayer.h"
+#include "../lib/racing_core.h"
+#include "../lib/scheduler.h"
+
+#define tick_hz 5 // the same speed as game_racing
+#define listen_slot mp_max_players // epoll data of the listening socket, the players use their seat number
+#define status_interval (5 * tick_hz) // ticks between two status lines
+#define hello_timeout_ns 1000000000ll // how long a new connection can hold a seat without saying MSG_HELLO
+
+typedef struct {
+    int fd; // -1 for a free seat
+    int seated; // said MSG_HELLO with our mp_version, until then the seat is held but there is no car
+    long long accepted_ns;
+    int car_x;
+    int crashed;
+    int direction; // the last key since the previous tick
+    int respawn;
+    int needs_keyframe; // joined, or missed a frame, deltas don't apply to what it shows anymore
+    long long pending_input_ns; // when the newest key not applied yet was read on the client, 0 if there is none
+
+    long long joined_ns;
+    long frames;
+    long keyframes;
+    long dropped;
+    long long bytes;
+    long inputs;
+    Histogram input_age; // from reading the key on the client to the tick that applied it
+} Player;
+
+static Road* road;
+static Player players[mp_max_players];
+static int num_players;
+
+// what every client should show, and what the last tick sent
+static char* grid;
+static char* shown;
+static unsigned char* delta_frame;
+static unsigned char* keyframe;
+
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static char socket_path[108];
+
+static Scheduler* scheduler;
+static EventLoop* loop;
+
+static long long bytes_since_status;
+
+static int open_listener(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+    unlink(path); // left behind by a server that didn't exit cleanly
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1 || listen(fd, mp_max_players) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// the middle lane if it is clear, otherwise the first clear one
+static int free_lane(void) {
+    if (!road_has_obstacle(road, road->width / 2, road->car_y))
+        return road->width / 2;
+    for (int x = 0; x < road->width; x++) {
+        if (!road_has_obstacle(road, x, road->car_y))
+            return x;
+    }
+    return road->width / 2;
+}
+
+static void accept_players(void) {
+    int fd;
+    while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        int slot = 0;
+        while (slot < mp_max_players && players[slot].fd != -1)
+            slot++;
+        if (slot == mp_max_players) {
+            const uint8_t full = MSG_FULL;
+            send(fd, &full, sizeof(full), MSG_DONTWAIT | MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+
+        // the car comes with the client's MSG_HELLO
+        Player* p = &players[slot];
+        memset(p, 0, sizeof(Player));
+        p->fd = fd;
+        p->accepted_ns = monotonic_ns();
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = slot};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+static void seat_player(const int slot) {
+    Player* p = &players[slot];
+    p->seated = 1;
+    p->car_x = free_lane();
+    p->needs_keyframe = 1;
+    p->joined_ns = monotonic_ns();
+
+    const WelcomeMsg welcome = {MSG_WELCOME, (uint8_t) slot, (uint8_t) road->width, (uint8_t) road->height, tick_hz};
+    send(p->fd, &welcome, sizeof(welcome), MSG_DONTWAIT | MSG_NOSIGNAL);
+    num_players++;
+    printf("player %d joined, %d playing\n", slot + 1, num_players);
+}
+
+static void report_player(const int slot) {
+    const Player* p = &players[slot];
+    const double seconds = (monotonic_ns() - p->joined_ns) / 1e9;
+    printf("player %d: %.1f s, %ld frames (%ld keyframes, %ld dropped), %lld bytes (%.0f B/s), %ld inputs, "
+           "input age p50<=%.1fms p99<=%.1fms\n", slot + 1, seconds, p->frames, p->keyframes, p->dropped, p->bytes,
+           seconds > 0 ? p->bytes / seconds : 0.0, p->inputs, histogram_percentile_ns(&p->input_age, 0.50) / 1e6,
+           histogram_percentile_ns(&p->input_age, 0.99) / 1e6);
+}
+
+static void drop_player(const int slot) {
+    Player* p = &players[slot];
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p->fd, NULL);
+    close(p->fd);
+    p->fd = -1;
+    if (!p->seated)
+        return; // never got a car
+    p->seated = 0;
+    num_players--;
+    printf("player %d left, %d playing\n", slot + 1, num_players);
+    report_player(slot);
+}
+
+static void read_inputs(const int slot) {
+    Player* p = &players[slot];
+    InputMsg input;
+    for (;;) {
+        const ssize_t n = recv(p->fd, &input, sizeof(input), MSG_DONTWAIT);
+        if (n == -1 && (errno == EAGAIN || errno == EINTR))
+            return;
+        if (n <= 0) {
+            drop_player(slot); // hung up
+            return;
+        }
+        if (!p->seated) {
+            // the first message has to be a MSG_HELLO in our version of the protocol, anything else can't be played with
+            HelloMsg hello;
+            memcpy(&hello, &input, sizeof(hello));
+            if (n != sizeof(hello) || hello.type != MSG_HELLO || hello.version != mp_version) {
+                const HelloMsg version = {MSG_VERSION, mp_version};
+                send(p->fd, &version, sizeof(version), MSG_DONTWAIT | MSG_NOSIGNAL);
+                printf("a client with protocol version %d was turned away\n", n == sizeof(hello) ? hello.version : -1);
+                drop_player(slot);
+                return;
+            }
+            seat_player(slot);
+            continue;
+        }
+        if (n != sizeof(input) || input.type != MSG_INPUT)
+            continue;
+
+        p->inputs++;
+        if (input.direction != neutral)
+            p->direction = input.direction < 0 ? left : right;
+        if (input.respawn)
+            p->respawn = 1;
+        p->pending_input_ns = input.sent_ns;
+    }
+}
+
+static void handle_clients(void) {
+    struct epoll_event events[mp_max_players + 1];
+    const int n = epoll_wait(epoll_fd, events, mp_max_players + 1, 0);
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.u32 == listen_slot)
+            accept_players();
+        else if (players[events[i].data.u32].fd != -1)
+            read_inputs((int) events[i].data.u32);
+    }
+}
+
+static void build_grid(void) {
+    for (int y = 0; y < road->height; y++) {
+        for (int x = 0; x < road->width; x++)
+            grid[y * road->width + x] = road_has_obstacle(road, x, y) ? char_obstacle : char_road;
+    }
+    // the lowest seat ends up on top when cars share a lane
+    for (int slot = mp_max_players - 1; slot >= 0; slot--) {
+        if (players[slot].seated)
+            grid[road->car_y * road->width + players[slot].car_x] = players[slot].crashed ? char_crash : '1' + slot;
+    }
+}
+
+static size_t encode_frame(unsigned char* frame, const uint8_t type, const unsigned long tick, const int all_cells) {
+    FrameHeader* header = (FrameHeader*) frame;
+    WireCell* cells = (WireCell*) (frame + sizeof(FrameHeader));
+    int count = 0;
+    for (int i = 0; i < road->width * road->height; i++) {
+        if (all_cells || grid[i] != shown[i])
+            cells[count++] = (WireCell) {(uint8_t) (i % road->width), (uint8_t) (i / road->width), grid[i]};
+    }
+    header->type = type;
+    header->players = num_players;
+    header->count = count;
+    header->tick = tick;
+    return sizeof(FrameHeader) + sizeof(WireCell) * count;
+}
+
+// never blocks: a client that can't take a frame right now misses it and gets the next keyframe instead
+static void send_frames(const unsigned long tick) {
+    const size_t delta_size = encode_frame(delta_frame, MSG_DELTA, tick, 0);
+    const int keyframe_due = tick % mp_keyframe_interval == 0;
+    size_t keyframe_size = 0;
+
+    for (int slot = 0; slot < mp_max_players; slot++) {
+        Player* p = &players[slot];
+        if (!p->seated)
+            continue;
+
+        const int send_keyframe = keyframe_due || p->needs_keyframe;
+        if (!send_keyframe && ((FrameHeader*) delta_frame)->count == 0)
+            continue; // nothing changed for this one
+        if (send_keyframe && keyframe_size == 0)
+            keyframe_size = encode_frame(keyframe, MSG_KEYFRAME, tick, 1);
+
+        const void* frame = send_keyframe ? keyframe : delta_frame;
+        const size_t size = send_keyframe ? keyframe_size : delta_size;
+        const ssize_t sent = send(p->fd, frame, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent == (ssize_t) size) {
+            p->frames++;
+            p->bytes += size;
+            bytes_since_status += size;
+            if (send_keyframe) {
+                p->keyframes++;
+                p->needs_keyframe = 0;
+            }
+        }
+        else {
+            p->dropped++;
+            p->needs_keyframe = 1; // a gone client shows up as a hangup on the next read
+        }
+    }
+}
+
+static void tick(const unsigned long tick) {
+    const long long now = monotonic_ns();
+    for (int slot = 0; slot < mp_max_players; slot++) {
+        Player* p = &players[slot];
+        // a connection that never says hello would keep its seat for good, and enough of them fill the game
+        if (p->fd != -1 && !p->seated && now - p->accepted_ns > hello_timeout_ns) {
+            printf("a client that didn't say hello in time was turned away\n");
+            drop_player(slot);
+        }
+        if (!p->seated)
+            continue;
+        if (p->pending_input_ns != 0) {
+            histogram_add(&p->input_age, now - p->pending_input_ns);
+            p->pending_input_ns = 0;
+        }
+        if (p->crashed && p->respawn) {
+            p->crashed = 0;
+            p->car_x = free_lane();
+        }
+        else if (!p->crashed)
+            p->car_x = racing_steer(road, p->car_x, p->direction);
+        p->direction = neutral;
+        p->respawn = 0;
+    }
+
+    racing_advance(road);
+
+    // whatever was one row above a car is now on its row
+    for (int slot = 0; slot < mp_max_players; slot++) {
+        Player* p = &players[slot];
+        if (p->seated && !p->crashed && road_has_obstacle(road, p->car_x, road->car_y))
+            p->crashed = 1;
+    }
+
+    build_grid();
+    send_frames(tick);
+    memcpy(shown, grid, road->width * road->height);
+}
+
+static void print_status(const unsigned long ticks) {
+    printf("tick %lu: %d playing, update p99<=%.1fus, jitter p99<=%.1fus, %ld dropped ticks, out %.0f B/s\n", ticks,
+           num_players, histogram_percentile_ns(&scheduler->update, 0.99) / 1000.0,
+           histogram_percentile_ns(&scheduler->jitter, 0.99) / 1000.0, scheduler->dropped_ticks,
+           bytes_since_status / ((double) status_interval / tick_hz));
+    fflush(stdout);
+    bytes_since_status = 0;
+}
+
+static void cleanup(void) {
+    for (int slot = 0; slot < mp_max_players; slot++) {
+        if (players[slot].fd != -1)
+            drop_player(slot);
+    }
+    if (listen_fd != -1) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    if (epoll_fd != -1)
+        close(epoll_fd);
+    scheduler_report_stats(scheduler, "vgc-server", stdout);
+    free_scheduler(scheduler);
+    free_event_loop(loop);
+    free_road(road);
+    free(grid);
+    free(shown);
+    free(delta_frame);
+    free(keyframe);
+}
+
+int main(int argc, char** argv) {
+    mp_default_socket(socket_path, sizeof(socket_path));
+    unsigned long seed = monotonic_ns();
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--socket") == 0)
+            snprintf(socket_path, sizeof(socket_path), "%s", argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = strtoul(argv[i + 1], NULL, 0);
+    }
+
+    loop = create_event_loop();
+    if (loop == NULL) {
+        printf("Failed to set up the event loop\n");
+        return 1;
+    }
+    loop->input_fd = -1; // no keyboard here, ctrl+c or SIGTERM stops the server
+
+    for (int slot = 0; slot < mp_max_players; slot++)
+        players[slot].fd = -1;
+    road = create_initial_road(road_width_inner, road_height, seed);
+    if (road == NULL) {
+        printf("Failed to allocate the road\n");
+        cleanup();
+        return 1;
+    }
+    const int cells = road->width * road->height;
+    grid = malloc(cells);
+    shown = calloc(cells, 1);
+    delta_frame = malloc(mp_max_frame(road->width, road->height));
+    keyframe = malloc(mp_max_frame(road->width, road->height));
+    if (grid == NULL || shown == NULL || delta_frame == NULL || keyframe == NULL) {
+        printf("Failed to allocate the frames\n");
+        cleanup();
+        return 1;
+    }
+
+    listen_fd = open_listener(socket_path);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (listen_fd == -1 || epoll_fd == -1) {
+        perror(socket_path);
+        cleanup();
+        return 1;
+    }
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.u32 = listen_slot};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+    // one fd for all the clients, the epoll set says which of them are readable
+    const int client_event = event_loop_add_fd(loop, epoll_fd);
+
+    scheduler = create_scheduler(tick_hz, tick_hz);
+    if (scheduler == NULL) {
+        printf("Failed to allocate the scheduler\n");
+        cleanup();
+        return 1;
+    }
+    event_loop_set_timer(loop, scheduler_timer_period_ns(scheduler));
+    printf("vgc-server listening on %s, join with: vgc-client --socket %s\n", socket_path, socket_path);
+    fflush(stdout);
+
+    int run = 1;
+    while (run) {
+        LoopEvents events = event_loop_wait(loop);
+
+        if (events.flags & EVENT_QUIT)
+            run = 0;
+        if (events.flags & client_event)
+            handle_clients();
+
+        if (events.flags & EVENT_TICK) {
+            const int due = scheduler_ticks_due(scheduler);
+            for (int i = 0; i < due; i++) {
+                scheduler_begin_update(scheduler);
+                tick(scheduler->ticks - due + i + 1);
+                scheduler_end_update(scheduler);
+            }
+            if (due > 0 && scheduler->ticks / status_interval != (scheduler->ticks - due) / status_interval)
+                print_status(scheduler->ticks);
+        }
+    }
+
+    cleanup();
+    return 0;
+}
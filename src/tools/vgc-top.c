@@ -0,0 +1,231 @@
+// live counters of every running game and console, refreshed once a second. Sessions publish them unless VGC_PERF=0
+// usage: vgc-top [--once]   --once prints one second's worth to stdout instead, q leaves
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ncurses.h>
+
+#include "../lib/clock.h"
+#include "../lib/event_loop.h"
+#include "../lib/perf.h"
+#include "../lib/render.h"
+
+#define max_sessions 64
+
+typedef struct {
+    uint64_t ticks;
+    uint64_t missed;
+    uint64_t tick_buckets[histogram_buckets];
+    uint64_t frames;
+    uint64_t cells;
+    uint64_t bytes;
+    uint64_t keys;
+    long long at_ns;
+} Sample;
+
+typedef struct {
+    pid_t pid;
+    const PerfBlock* block;
+    Sample last;
+    Sample now;
+    int samples; // rates need two
+} Session;
+
+static Session sessions[max_sessions];
+static int num_sessions;
+
+static int contains(const pid_t* pids, const int n, const pid_t pid) {
+    for (int i = 0; i < n; i++) {
+        if (pids[i] == pid)
+            return 1;
+    }
+    return 0;
+}
+
+static uint64_t load(const _Atomic uint64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void take_sample(Session* s) {
+    const PerfBlock* p = s->block;
+    Sample* x = &s->now;
+    s->last = *x;
+    x->ticks = load(&p->ticks);
+    x->missed = load(&p->missed_deadlines);
+    for (int i = 0; i < histogram_buckets; i++)
+        x->tick_buckets[i] = load(&p->tick_buckets[i]);
+    x->frames = load(&p->frames);
+    x->cells = load(&p->cells_changed);
+    x->bytes = load(&p->bytes_written);
+    x->keys = load(&p->keys);
+    x->at_ns = monotonic_ns();
+    s->samples++;
+}
+
+// attaches to the sessions that started since the last call, drops the ones that ended, then samples them all
+static void refresh_sessions(void) {
+    pid_t pids[max_sessions];
+    const int n = perf_find_all(pids, max_sessions);
+
+    int kept = 0;
+    pid_t known[max_sessions];
+    for (int i = 0; i < num_sessions; i++) {
+        if (!atomic_load(&sessions[i].block->closed) && contains(pids, n, sessions[i].pid)) {
+            known[kept] = sessions[i].pid;
+            sessions[kept++] = sessions[i];
+        }
+        else
+            perf_detach(sessions[i].block);
+    }
+    num_sessions = kept;
+
+    for (int j = 0; j < n && num_sessions < max_sessions; j++) {
+        if (contains(known, kept, pids[j]))
+            continue;
+        const PerfBlock* block = perf_attach(pids[j]);
+        if (block != NULL)
+            sessions[num_sessions++] = (Session) {.pid = pids[j], .block = block};
+    }
+
+    for (int i = 0; i < num_sessions; i++)
+        take_sample(&sessions[i]);
+}
+
+// the upper bound of the bucket the p-th of the ticks in the last second fell in
+static double percentile_us(const Session* s, const double p) {
+    const uint64_t count = s->now.ticks - s->last.ticks;
+    if (count == 0)
+        return 0;
+    const uint64_t rank = (uint64_t) (p * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < histogram_buckets; i++) {
+        seen += s->now.tick_buckets[i] - s->last.tick_buckets[i];
+        if (seen >= rank)
+            return (double) (1ull << i);
+    }
+    return (double) (1ull << (histogram_buckets - 1));
+}
+
+static void format_bytes(char* out, const size_t size, const double bytes) {
+    if (bytes >= 1 << 20)
+        snprintf(out, size, "%.1fM", bytes / (1 << 20));
+    else if (bytes >= 1 << 10)
+        snprintf(out, size, "%.1fK", bytes / (1 << 10));
+    else
+        snprintf(out, size, "%.0f", bytes);
+}
+
+static const char* header_line(void) {
+    return "    PID NAME              HZ  TICK/S  MISSED  P50<=us  P99<=us  FRAME/S  CELLS/S  BYTES/S  KEYS/S DEPTH   HEAP";
+}
+
+static void format_session(const Session* s, char* line, const size_t size) {
+    char name[sizeof(s->block->name)];
+    perf_read_name(s->block, name, sizeof(name));
+    const PerfBlock* p = s->block;
+    const double seconds = s->samples < 2 ? 0 : (s->now.at_ns - s->last.at_ns) / 1e9;
+    char heap[16];
+    format_bytes(heap, sizeof(heap), load(&p->heap_bytes));
+    if (seconds <= 0) { // just attached, the rates come with the next sample
+        snprintf(line, size, "%7d %-16.16s %3lu", (int) s->pid, name, (unsigned long) load(&p->tick_hz));
+        return;
+    }
+
+    char bytes[16];
+    format_bytes(bytes, sizeof(bytes), (s->now.bytes - s->last.bytes) / seconds);
+    snprintf(line, size, "%7d %-16.16s %3lu %7.0f %7lu %8.0f %8.0f %8.0f %8.0f %8s %7.1f %5lu %6s", (int) s->pid, name,
+             (unsigned long) load(&p->tick_hz), (s->now.ticks - s->last.ticks) / seconds,
+             (unsigned long) s->now.missed, percentile_us(s, 0.50), percentile_us(s, 0.99),
+             (s->now.frames - s->last.frames) / seconds, (s->now.cells - s->last.cells) / seconds, bytes,
+             (s->now.keys - s->last.keys) / seconds, (unsigned long) load(&p->input_depth), heap);
+}
+
+static void draw(Renderer* renderer) {
+    char line[256];
+    renderer_clear(renderer);
+    renderer_print(renderer, 0, 0, "vgc-top: %d session%s, rates over the last second, q leaves", num_sessions,
+                   num_sessions == 1 ? "" : "s");
+    renderer_print(renderer, 0, 2, "%s", header_line());
+    for (int i = 0; i < num_sessions && i + 3 < renderer->rows; i++) {
+        format_session(&sessions[i], line, sizeof(line));
+        renderer_print(renderer, 0, i + 3, "%s", line);
+    }
+    if (num_sessions == 0)
+        renderer_print(renderer, 0, 3, "no sessions running, or all of them started with VGC_PERF=0");
+}
+
+static int print_once(void) {
+    refresh_sessions();
+    usleep(1000000);
+    refresh_sessions();
+
+    char line[256];
+    printf("%s\n", header_line());
+    for (int i = 0; i < num_sessions; i++) {
+        format_session(&sessions[i], line, sizeof(line));
+        printf("%s\n", line);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsetenv("VGC_SPECTATE"); // our own screen isn't worth publishing
+    if (argc > 1 && strcmp(argv[1], "--once") == 0)
+        return print_once();
+
+    EventLoop* loop = create_event_loop();
+    if (loop == NULL) {
+        printf("Failed to set up the event loop\n");
+        return 1;
+    }
+
+    init_terminal();
+    Renderer* renderer = create_renderer(COLS, LINES);
+    if (renderer == NULL) {
+        endwin();
+        printf("Failed to allocate the screen buffers\n");
+        free_event_loop(loop);
+        return 1;
+    }
+    refresh_sessions();
+    draw(renderer);
+    renderer_flush(renderer);
+
+    event_loop_set_timer(loop, 1000000000ll);
+    int run = 1;
+    while (run) {
+        LoopEvents events = event_loop_wait(loop);
+
+        if (events.flags & EVENT_QUIT)
+            run = 0;
+        if (events.flags & EVENT_RESIZE) {
+            renderer_resize_to_terminal(renderer);
+            draw(renderer);
+            renderer_flush(renderer);
+        }
+        if (events.flags & EVENT_INPUT) {
+            int ch;
+            while ((ch = getch()) != ERR) {
+                if (ch == 'q' || ch == 'Q')
+                    run = 0;
+            }
+        }
+
+        if (events.flags & EVENT_TICK) {
+            refresh_sessions();
+            draw(renderer);
+            renderer_flush(renderer);
+        }
+    }
+
+    clear();
+    endwin();
+    system("clear");
+    for (int i = 0; i < num_sessions; i++)
+        perf_detach(sessions[i].block);
+    free_renderer(renderer);
+    free_event_loop(loop);
+    return 0;
+}
@@ -0,0 +1,98 @@
+// converts --trace files into Chrome trace JSON, open the result in chrome://tracing or ui.perfetto.dev
+// usage: vgc-trace2json <trace file>... > trace.json
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../lib/trace.h"
+
+static int first_event = 1;
+
+static void begin_event(const TraceHeader* header, const TraceRecord* r, const char* name, const char* phase) {
+    printf("%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u", first_event ? "" : ",", name, phase,
+           r->ts_ns / 1000.0, header->pid, header->pid);
+    first_event = 0;
+}
+
+static void convert_record(const TraceHeader* header, const TraceRecord* r) {
+    switch (r->type) {
+        case TRACE_INPUT:
+            begin_event(header, r, "input", "i");
+            printf(",\"s\":\"t\",\"args\":{\"key\":%u}}", r->arg);
+            break;
+        case TRACE_TICK_BEGIN:
+            begin_event(header, r, "tick", "B");
+            printf(",\"args\":{\"tick\":%u}}", r->arg);
+            break;
+        case TRACE_TICK_END:
+            begin_event(header, r, "tick", "E");
+            printf("}");
+            break;
+        case TRACE_RENDER_BEGIN:
+            begin_event(header, r, "render", "B");
+            printf("}");
+            break;
+        case TRACE_RENDER_END:
+            begin_event(header, r, "render", "E");
+            printf(",\"args\":{\"bytes\":%u}}", r->arg);
+            break;
+        case TRACE_LAUNCH_BEGIN:
+            begin_event(header, r, "game", "B");
+            printf(",\"args\":{\"game\":%u}}", r->arg);
+            break;
+        case TRACE_LAUNCH_END:
+            begin_event(header, r, "game", "E");
+            printf(",\"args\":{\"status\":%u}}", r->arg);
+            break;
+        case TRACE_DROPPED:
+            begin_event(header, r, "dropped", "i");
+            printf(",\"s\":\"p\",\"args\":{\"records\":%u}}", r->arg);
+            break;
+        default:
+            break;
+    }
+}
+
+static int convert_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+    header.name[sizeof(header.name) - 1] = '\0';
+
+    printf("%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+           first_event ? "" : ",", header.pid, header.pid, header.name);
+    first_event = 0;
+
+    TraceRecord records[4096];
+    size_t n;
+    while ((n = fread(records, sizeof(TraceRecord), 4096, f)) > 0) {
+        for (size_t i = 0; i < n; i++)
+            convert_record(&header, &records[i]);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace file>... > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (int i = 1; i < argc; i++)
+        failed |= convert_file(argv[i]);
+    printf("\n]}\n");
+    return failed;
+}
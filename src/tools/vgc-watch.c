@@ -0,0 +1,139 @@
+// watches a game or the console from another terminal, read-only. Start the one to watch with VGC_SPECTATE=1
+// usage: vgc-watch [pid]   without a pid it follows the newest session, into a game and back to the menu, q leaves
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+
+#include "../lib/event_loop.h"
+#include "../lib/render.h"
+#include "../lib/spectate.h"
+
+#define watch_hz 30 // how often the ring is read, the producer doesn't wait for us either way
+
+static SpectateView* view;
+static pid_t watched;
+static char* grid;
+
+// a blank grid the size of v's screen, NULL if it couldn't be allocated
+static char* create_grid(const SpectateView* v) {
+    char* g = malloc(v->header->cols * v->header->rows);
+    if (g != NULL)
+        memset(g, ' ', v->header->cols * v->header->rows);
+    return g;
+}
+
+// keeps watching the current session if the new one can't be attached
+static void attach(Renderer* renderer, const pid_t pid) {
+    SpectateView* next = spectate_attach(pid);
+    if (next == NULL)
+        return;
+    char* next_grid = create_grid(next);
+    if (next_grid == NULL) {
+        spectate_detach(next);
+        return;
+    }
+    spectate_detach(view);
+    free(grid);
+    view = next;
+    grid = next_grid;
+    watched = pid;
+    renderer_clear(renderer);
+}
+
+static void draw(Renderer* renderer) {
+    const int status_row = renderer->rows - 1;
+    if (view == NULL) {
+        renderer_print(renderer, 0, status_row, "waiting for a session started with VGC_SPECTATE=1");
+        return;
+    }
+
+    const SpectateHeader* h = view->header;
+    for (int y = 0; y < (int) h->rows && y < status_row; y++) {
+        for (int x = 0; x < (int) h->cols; x++)
+            renderer_put(renderer, x, y, grid[y * h->cols + x]);
+    }
+    renderer_print(renderer, 0, status_row, "watching %s (%d)%s  frame %ld  behind %lu  skipped to a keyframe %ld times",
+                   h->name, (int) h->pid, h->closed ? ", ended" : "", view->frames,
+                   (unsigned long) spectate_lag(view), view->jumps);
+}
+
+int main(int argc, char** argv) {
+    unsetenv("VGC_SPECTATE"); // our own screen isn't worth publishing
+    const int follow = argc < 2;
+
+    EventLoop* loop = create_event_loop();
+    if (loop == NULL) {
+        printf("Failed to set up the event loop\n");
+        return 1;
+    }
+
+    pid_t pid = follow ? spectate_find_newest() : atoi(argv[1]);
+    if (!follow && ((view = spectate_attach(pid)) == NULL || (grid = create_grid(view)) == NULL)) {
+        printf("Nothing to watch for pid %d: %s\n", (int) pid, strerror(view == NULL ? errno : ENOMEM));
+        spectate_detach(view);
+        free_event_loop(loop);
+        return 1;
+    }
+
+    init_terminal();
+    Renderer* renderer = create_renderer(COLS, LINES);
+    if (renderer == NULL) {
+        endwin();
+        printf("Failed to allocate the screen buffers\n");
+        spectate_detach(view);
+        free(grid);
+        free_event_loop(loop);
+        return 1;
+    }
+    if (view != NULL)
+        watched = pid;
+    else if (pid != 0)
+        attach(renderer, pid);
+
+    event_loop_set_timer(loop, 1000000000ll / watch_hz);
+    long wakeups = 0;
+    int run = 1;
+    while (run) {
+        LoopEvents events = event_loop_wait(loop);
+
+        if (events.flags & EVENT_QUIT)
+            run = 0;
+        if (events.flags & EVENT_RESIZE)
+            renderer_resize_to_terminal(renderer);
+        if (events.flags & EVENT_INPUT) {
+            int ch;
+            while ((ch = getch()) != ERR) {
+                if (ch == 'q' || ch == 'Q')
+                    run = 0;
+            }
+        }
+
+        if (events.flags & EVENT_TICK) {
+            // once a second, or right away when the watched one ended, look for a newer session to follow
+            if (follow && (++wakeups % watch_hz == 0 || (view != NULL && view->header->closed))) {
+                pid = spectate_find_newest();
+                if (pid != 0 && pid != watched)
+                    attach(renderer, pid);
+            }
+            if (view != NULL)
+                spectate_read(view, grid);
+            draw(renderer);
+            renderer_flush(renderer);
+        }
+    }
+
+    clear();
+    endwin();
+    system("clear");
+    if (view != NULL && getenv("VGC_STATS") != NULL)
+        fprintf(stderr, "vgc-watch: %ld frames read, skipped to a keyframe %ld times\n", view->frames, view->jumps);
+    renderer_report_stats(renderer, "vgc-watch", stderr);
+    spectate_detach(view);
+    free(grid);
+    free_renderer(renderer);
+    free_event_loop(loop);
+    return 0;
+}
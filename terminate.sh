@@ -1,14 +1,15 @@
 
-# unmount the vgc-disk image and remove all files created by startup.sh
-# (detach the device file, remove it and its symbolic link)
+# the bundle needs no mount or loop device, this only tears down what the old loop image setup
+# (startup.sh before bundles) may have left behind
 
-sudo umount mount
-sudo rm /dev/vgc-disk
-rm -r mount
-rm vgc-disk
+if mountpoint -q mount 2>/dev/null; then
+    sudo umount mount
+fi
+[ -d mount ] && rm -r mount
+[ -e /dev/vgc-disk ] && sudo rm /dev/vgc-disk
+[ -L vgc-disk ] && rm vgc-disk
 
-if sudo losetup -a | grep -q "storage_vgc.img"; then
+if [ -e storage_vgc.img ] && sudo losetup -a | grep -q "storage_vgc.img"; then
     loop_device=$(sudo losetup -a | grep "storage_vgc.img" | cut -d ':' -f 1)
     sudo losetup -d "$loop_device"
 fi
-